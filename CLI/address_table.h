@@ -0,0 +1,73 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <xmmintrin.h>
+
+// Maps an address to the symbol containing it.
+// The start offsets are kept in eytzinger (breadth first) order, so a lookup walks the array from the front,
+// the first levels of the implicit tree share a few cache lines and the next ones can be prefetched ahead.
+class AddressTable {
+public:
+  struct Entry {
+    uint64_t offset, size;
+    std::string name;
+  };
+
+  AddressTable() = default;
+
+  explicit AddressTable(std::vector<Entry> list) : entries(std::move(list)) {
+    std::sort(entries.begin(), entries.end(), [](Entry const &a, Entry const &b) {
+      return a.offset != b.offset ? a.offset < b.offset : a.size > b.size;
+    });
+    // aliases share the start offset, keep the widest one
+    entries.erase(
+        std::unique(
+            entries.begin(), entries.end(), [](Entry const &a, Entry const &b) { return a.offset == b.offset; }),
+        entries.end());
+    // symbols without size extend up to the next one, the last one only covers its own address
+    for (size_t i = 0; i < entries.size(); i++)
+      if (entries[i].size == 0)
+        entries[i].size = i + 1 < entries.size() ? entries[i + 1].offset - entries[i].offset : 1;
+
+    keys.resize(entries.size() + 1);
+    ranks.resize(entries.size() + 1);
+    ranks[0] = (uint32_t) entries.size();
+    size_t i = 0;
+    build(i, 1);
+  }
+
+  // returns the symbol containing address, or nullptr
+  Entry const *find(uint64_t address) const {
+    size_t k = 1, n = keys.size();
+    while (k < n) {
+      _mm_prefetch((char const *) (keys.data() + std::min(k * 16, n - 1)), _MM_HINT_T0);
+      k = 2 * k + (keys[k] <= address);
+    }
+    // strip the trailing right turns, leaving the first key greater than address (0 when there is none)
+    k >>= std::countr_one(k) + 1;
+    auto rank = ranks[k];
+    if (rank == 0) return nullptr;
+    auto &entry = entries[rank - 1];
+    if (address - entry.offset >= entry.size) return nullptr;
+    return &entry;
+  }
+
+  size_t size() const { return entries.size(); }
+
+private:
+  std::vector<Entry> entries;  // sorted by offset
+  std::vector<uint64_t> keys;  // start offsets in eytzinger order, 1-based
+  std::vector<uint32_t> ranks; // index into entries for each node, ranks[0] is the end
+
+  void build(size_t &i, size_t k) {
+    if (k >= keys.size()) return;
+    build(i, 2 * k);
+    keys[k]  = entries[i].offset;
+    ranks[k] = (uint32_t) i++;
+    build(i, 2 * k + 1);
+  }
+};
@@ -1,4 +1,5 @@
 #include <elf.h>
+#include <pe.h>
 #include <pdb.h>
 #include <Demangle.h>
 #include <ItaniumDemangle.h>
@@ -12,18 +13,31 @@
 #include <io.h>
 #include <sqlite3.h>
 #include <SymbolTokenizer.h>
+#include "address_table.h"
+#include "typeinfo_graph.h"
 
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <chrono>
 #include <map>
+#include <tuple>
 #include <unordered_map>
-#include <unordered_set>
+#include <algorithm>
 #include <span>
+#include <charconv>
+#include <format>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_set>
+#include <thread>
+#include <TaskPool.h>
+#include <symindex.h>
+#include <winsock2.h>
+#include <afunix.h>
 #include <windowscommon.h>
 
-enum struct FileType { PdbFile, ElfFile, UnknownFile };
+enum struct FileType { PdbFile, ElfFile, PeFile, DatabaseFile, IndexFile, UnknownFile };
 enum struct DecodeMode { Raw, Simple, Original };
 
 void dumpELF(std::filesystem::path const &file, DecodeMode mode) {
@@ -50,9 +64,11 @@ void dumpELF(std::filesystem::path const &file, DecodeMode mode) {
   } while (it->Next());
 }
 
-void dumpPDB(std::filesystem::path const &file, DecodeMode mode) {
-  auto dumper = pdb::GetDumper().Open(file);
+// msvc decorated symbols, from a pdb or from the tables of a pe image
+void dumpPDB(std::filesystem::path const &file, DecodeMode mode, common::ISymbolDumper &source = pdb::GetDumper()) {
+  auto dumper = source.Open(file);
   auto it     = dumper->GetIterator();
+  if (!it) throw std::runtime_error{"No symbol in source file."};
   do {
     auto sym = it->Get();
     if (sym.Offset) {
@@ -78,12 +94,35 @@ void printHelp() {
   std::wcerr << L"symutils" << std::endl << std::endl;
   std::wcerr << L"\thelp                             Print this message." << std::endl;
   std::wcerr << L"\telf-sections <source>            Print elf sections for elf." << std::endl;
-  std::wcerr << L"\tdump <source>                    Dump symbol in raw form from pdb or elf." << std::endl;
-  std::wcerr << L"\tdump-decode <source>             Dump symbol in simple form from pdb or elf." << std::endl;
-  std::wcerr << L"\tdump-decode-original <source>    Dump symbol in original form from pdb or elf." << std::endl;
+  std::wcerr << L"\tdump <source>                    Dump symbol in raw form from pdb, pe or elf." << std::endl;
+  std::wcerr << L"\tdump-decode <source>             Dump symbol in simple form from pdb, pe or elf." << std::endl;
+  std::wcerr << L"\tdump-decode-original <source>    Dump symbol in original form from pdb, pe or elf." << std::endl;
   std::wcerr << L"\tdecode [symbol]                  Decode symbol in simple form if possible." << std::endl;
   std::wcerr << L"\tdecode-original [symbol]         Decode symbol in original form if possible." << std::endl;
-  std::wcerr << L"\tbuild-database <out> <pdb> <elf> Build database from pdb and elf files." << std::endl;
+  std::wcerr << L"\tbuild-database <out> <pdb> <elf> Build database and .symidx index from pdb and elf files,"
+             << std::endl;
+  std::wcerr << L"\t                                 pdb can also be a pe image, its exports, imports and coff symbols"
+             << std::endl;
+  std::wcerr << L"\t                                 are read instead." << std::endl;
+  std::wcerr << L"\t  [exe]                          windows vtables and type infos come from the rtti of exe."
+             << std::endl;
+  std::wcerr << L"\tmerge-database <out> <ver> <db>  Add a release database built by build-database to the"
+             << std::endl;
+  std::wcerr << L"\t                                 multi-release database out as version ver, in release order."
+             << std::endl;
+  std::wcerr << L"\tsymbolize <source> <original>    Resolve hex offsets from stdin against a database or .symidx,"
+             << std::endl;
+  std::wcerr << L"\t                                 original is windows or linux." << std::endl;
+  std::wcerr << L"\tsymbolize-frames <source> [in]   Resolve module+0xOFFSET frames from stdin or file against"
+             << std::endl;
+  std::wcerr << L"\t                                 a database or an elf." << std::endl;
+  std::wcerr << L"\tdiff <old> <new>                 Print removed, added and moved symbols and changed vtable"
+             << std::endl;
+  std::wcerr << L"\t                                 layouts between two pdb, pe or elf files, vtables are only"
+             << std::endl;
+  std::wcerr << L"\t                                 compared between pe or elf files." << std::endl;
+  std::wcerr << L"\tserve <socket> <source>          Answer decode, symbolize and search requests on a unix socket."
+             << std::endl;
 }
 
 int unknownCommand(wchar_t const *cmd) {
@@ -102,6 +141,9 @@ FileType detectFileType(std::ifstream &file) {
           "ELF",
           4) == 0)
     return FileType::ElfFile;
+  if (strncmp(sig, "SQLi", 4) == 0) return FileType::DatabaseFile;
+  if (strncmp(sig, symindex::Magic, 4) == 0) return FileType::IndexFile;
+  if (strncmp(sig, "MZ", 2) == 0) return FileType::PeFile;
   return FileType::UnknownFile;
 }
 
@@ -113,6 +155,7 @@ void dump(std::filesystem::path path, DecodeMode mode = DecodeMode::Raw) {
   switch (type) {
   case FileType::PdbFile: dumpPDB(path, mode); break;
   case FileType::ElfFile: dumpELF(path, mode); break;
+  case FileType::PeFile: dumpPDB(path, mode, pe::GetDumper()); break;
   case FileType::UnknownFile: throw std::runtime_error{"Unknown source file."};
   default: break;
   }
@@ -150,18 +193,19 @@ std::string decodeElf(std::string const &str) {
   return str;
 }
 
+std::string decodeSymbol(std::string const &str, DecodeMode mode) {
+  if (mode == DecodeMode::Original) return llvm::demangle(str);
+  switch (str[0]) {
+  case '?': return decodePdb(str);
+  case '_': return decodeElf(str);
+  default: return str;
+  }
+}
+
 void do_DecodeSymbol(wchar_t const *wstr, DecodeMode mode) {
   auto str = fastcvt(wstr);
   if (str.empty()) return;
-  if (mode == DecodeMode::Original) {
-    std::cout << llvm::demangle(str) << std::endl;
-    return;
-  }
-  switch (str[0]) {
-  case '?': std::cout << decodePdb(str) << std::endl; break;
-  case '_': std::cout << decodeElf(str) << std::endl; break;
-  default: std::cout << str << std::endl;
-  }
+  std::cout << decodeSymbol(str, mode) << std::endl;
 }
 
 void loop_DecodeSymbol(DecodeMode mode) {
@@ -181,6 +225,22 @@ struct sqlerr {
   }
 };
 
+// PRAGMA user_version of the databases built by this version
+//   2: symbols.offset of windows symbols is the rva, it was the section relative offset of the pdb before
+constexpr int DatabaseVersion = 2;
+
+// a database of another version still opens but resolves to wrong offsets, so lookups refuse it
+void checkDatabaseVersion(sqlite3 *db, char const *schema = "main") {
+  sqlite3_stmt *stmt{};
+  auto text  = std::format("PRAGMA {}.user_version;", schema);
+  sqlerr{db} = sqlite3_prepare_v2(db, text.c_str(), -1, &stmt, nullptr);
+  std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)> guard{stmt, sqlite3_finalize};
+  if (auto res = sqlite3_step(stmt); res != SQLITE_ROW) sqlerr{db} = res;
+  if (auto version = sqlite3_column_int(stmt, 0); version != DatabaseVersion)
+    throw std::runtime_error{std::format(
+        "Database version {} is not supported, expect {}. Rebuild it with build-database.", version, DatabaseVersion)};
+}
+
 class stopwatch {
   bool has_skip = false;
   std::chrono::milliseconds dur;
@@ -225,101 +285,52 @@ public:
 };
 
 struct DatabaseBuilder {
-  enum struct ClassKind {
-    NoInherit,
-    SingleInherit,
-    VirtualMulitiInherit,
-  };
-
-  struct ClassTypeInfo {
-    struct FillContext {
-      sqlite3 *db;
-      sqlite3_stmt *root{}, *child{};
-
-      FillContext(sqlite3 *db) : db(db) {
-        sqlerr{db} = sqlite3_prepare_v3(
-            db, "INSERT INTO typeinfos VALUES(?, ?, ?);", -1, SQLITE_PREPARE_PERSISTENT, &root, nullptr);
-        sqlerr{db} = sqlite3_prepare_v3(
-            db, "INSERT INTO typeinfo_defs VALUES(?, ?, ?, ?);", -1, SQLITE_PREPARE_PERSISTENT, &child, nullptr);
-      }
-
-      ~FillContext() {
-        sqlite3_finalize(root);
-        sqlite3_finalize(child);
-      }
-
-      void FillRoot(uint64_t base, int type, uint64_t flags) {
-        sqlite3_reset(root);
-        sqlite3_clear_bindings(root);
-        sqlerr{db} = sqlite3_bind_int64(root, 1, (int64_t) base);
-        sqlerr{db} = sqlite3_bind_int(root, 2, type);
-        sqlerr{db} = sqlite3_bind_int64(root, 3, (int64_t) flags);
-        if (auto res = sqlite3_step(root); res != SQLITE_DONE) sqlerr{db} = res;
-      }
-
-      void FillChild(uint64_t base, uint64_t target, int64_t offset, int flags) {
-        sqlite3_reset(child);
-        sqlite3_clear_bindings(child);
-        sqlerr{db} = sqlite3_bind_int64(child, 1, (int64_t) base);
-        sqlerr{db} = sqlite3_bind_int64(child, 2, (int64_t) target);
-        sqlerr{db} = sqlite3_bind_int64(child, 3, offset);
-        sqlerr{db} = sqlite3_bind_int(child, 4, flags);
-        if (auto res = sqlite3_step(child); res != SQLITE_DONE) sqlerr{db} = res;
-      }
-    };
-
-    virtual ~ClassTypeInfo()                           = default;
-    virtual void Fill(uint64_t root, FillContext &ctx) = 0;
-  };
-
-  struct NoInheritClassTypeInfo : ClassTypeInfo {
-    NoInheritClassTypeInfo() = default;
-    virtual void Fill(uint64_t root, FillContext &ctx) override { ctx.FillRoot(root, 0, 0); }
-  };
-
-  struct SingleInheritClassTypeInfo : ClassTypeInfo {
-    uint64_t base;
-    SingleInheritClassTypeInfo(uint64_t base) : base(base) {}
-
-    virtual void Fill(uint64_t root, FillContext &ctx) override {
-      ctx.FillRoot(root, 1, 0);
-      ctx.FillChild(root, base, 0, 0);
-    }
-  };
-
-  struct VirtualMultiInheritClassTypeInfo : ClassTypeInfo {
-    uint64_t flags{};
-    struct ClassDesc {
-      uint64_t base{};
-      int64_t offset_flags{};
-    };
-    std::vector<ClassDesc> bases;
-
-    VirtualMultiInheritClassTypeInfo() = default;
-
-    virtual void Fill(uint64_t root, FillContext &ctx) override {
-      ctx.FillRoot(root, 2, flags);
-      for (auto base : bases) { ctx.FillChild(root, base.base, base.offset_flags >> 8, base.offset_flags & 0xFF); }
-    }
-  };
-
   std::filesystem::path const &out;
   std::filesystem::path const &pdb;
   std::filesystem::path const &elf;
+  std::filesystem::path const &exe; // optional, for the windows vtables and type infos
   sqlite3 *db{};
   sqlite3_stmt *stmt{}, *vtable_stmt{};
-  std::optional<elf::SectionData> rodata;
-  std::map<uint64_t, std::span<uint64_t>> vtables;
-  std::map<uint64_t, std::unique_ptr<ClassTypeInfo>> typeinfos;
+  std::optional<elf::AddressSpace> image;
+  TypeInfoGraph typeinfos;
+  std::vector<uint64_t> vmiBases; // scratch for the __vmi_class_type_info being decoded
+  std::vector<int64_t> vmiOffsetFlags;
   char *errmsg = nullptr;
   std::ostringstream oss;
-  std::unordered_map<uint64_t, ClassKind> relocmap;
-  std::unordered_set<uint64_t> pureset;
+  elf::RelocationIndex relocations;
+  uint32_t pureSymbol{};         // __cxa_pure_virtual in .dynsym
+  uint32_t typeinfoSymbols[3]{}; // __cxxabiv1 vtable of every TypeInfoGraph::Kind
+
+  // a vtable group (_ZTV) holds the primary vtable followed by the secondary ones
+  struct Vtable {
+    int position;          // slot of the address point within the group
+    int64_t offsetToTop{};
+    uint64_t typeinfo{};
+    std::vector<int64_t> offsets; // vcall and vbase offsets in memory order, preceding offset to top
+    std::vector<uint64_t> slots;  // 0 for pure virtual functions
+  };
+  struct VtableSymbol {
+    uint64_t offset, size;
+  };
+  std::vector<VtableSymbol> vtableSymbols;
+
+  // scopes tree, every name piece is interned once under its parent (0 for the root)
+  enum struct ScopeKind { Namespace = 0, Class = 1, Function = 2 };
+  struct Scope {
+    int64_t parent;
+    std::string name;
+    ScopeKind kind;
+  };
+  std::map<std::pair<int64_t, std::string>, int64_t> scopeIds;
+  std::vector<Scope> scopes;
+  int64_t scope{}; // scope of the symbol being decoded
 
   DatabaseBuilder(DatabaseBuilder const &) = delete;
 
-  DatabaseBuilder(std::filesystem::path const &out, std::filesystem::path const &pdb, std::filesystem::path const &elf)
-      : out(out), pdb(pdb), elf(elf) {}
+  DatabaseBuilder(
+      std::filesystem::path const &out, std::filesystem::path const &pdb, std::filesystem::path const &elf,
+      std::filesystem::path const &exe)
+      : out(out), pdb(pdb), elf(elf), exe(exe) {}
 
   ~DatabaseBuilder() {
     if (stmt) sqlerr{db} = sqlite3_finalize(stmt);
@@ -327,16 +338,22 @@ struct DatabaseBuilder {
     if (db) sqlerr{db} = sqlite3_close(db);
   }
 
+  // a pe image passed in place of the pdb gives its exports, imports and coff symbols
+  common::ISymbolDumper &windowsDumper() {
+    std::ifstream ifs{pdb};
+    if (!ifs) throw std::runtime_error{"Failed to open pdb file"};
+    return detectFileType(ifs) == FileType::PeFile ? pe::GetDumper() : pdb::GetDumper();
+  }
+
   void operator()() {
     std::cerr << "open pdb file..." << std::endl;
-    auto pdb_dumper = pdb::GetDumper().Open(pdb);
+    auto pdb_dumper = windowsDumper().Open(pdb);
     std::cerr << "open elf file..." << std::endl;
     auto elf_dumper = elf::GetDumper().Open(elf);
 
     std::cerr << "prepare relocation table for type info..." << std::endl;
     auto &dumper = *(elf::IElfDumpSource *) elf_dumper.get();
-    rodata       = dumper.GetSection(".data.rel.ro");
-    if (!rodata) throw std::runtime_error{"Failed to load .data.rel.ro section"};
+    image        = dumper.GetAddressSpace();
     {
       auto dynstr = dumper.GetSection(".dynstr");
       if (!dynstr) throw std::runtime_error{"Failed to load .dynsym section"};
@@ -346,49 +363,34 @@ struct DatabaseBuilder {
       if (!dynsym) throw std::runtime_error{"Failed to load .dynsym section"};
       common::MappingView<elf::symbol_data> esyms = std::move(dynsym->data);
 
-      auto rela = dumper.GetSection(".rela.dyn");
-      if (!rela) throw std::runtime_error{"Failed to load .rela.dyn section"};
-      common::MappingView<elf::elf_rela> erela = std::move(rela->data);
-
-      uint64_t pure = 0;
-      uint64_t vmi  = 0;
-      uint64_t si   = 0;
-      uint64_t ni   = 0;
-
       for (auto &sym : esyms) {
         auto str = dynstr->GetMapped(sym.st_name);
         if (sym.st_value == 0) {
           if (strncmp("_ZTVN10__cxxabiv1", str, 17) == 0) {
             if (strncmp("21__vmi_class_type_infoE", str + 17, 24) == 0) {
-              vmi = &sym - esyms.begin();
+              typeinfoSymbols[TypeInfoGraph::VirtualMultiInherit] = (uint32_t) (&sym - esyms.begin());
             } else if (strncmp("20__si_class_type_infoE", str + 17, 23) == 0) {
-              si = &sym - esyms.begin();
+              typeinfoSymbols[TypeInfoGraph::SingleInherit] = (uint32_t) (&sym - esyms.begin());
             } else if (strncmp("17__class_type_infoE", str + 17, 20) == 0) {
-              ni = &sym - esyms.begin();
+              typeinfoSymbols[TypeInfoGraph::NoInherit] = (uint32_t) (&sym - esyms.begin());
             }
           } else if (strcmp("__cxa_pure_virtual", str) == 0) {
-            pure = &sym - esyms.begin();
+            pureSymbol = (uint32_t) (&sym - esyms.begin());
           }
         }
       }
 
-      if (vmi == 0 || si == 0 || ni == 0 || pure == 0) throw std::runtime_error{"Failed to found vmi or si type info"};
-
-      for (auto &rela : erela) {
-        if (rela.r_type != 1) continue;
-        if (rela.r_sym == ni)
-          relocmap[rela.offset] = ClassKind::NoInherit;
-        else if (rela.r_sym == si)
-          relocmap[rela.offset] = ClassKind::SingleInherit;
-        else if (rela.r_sym == vmi)
-          relocmap[rela.offset] = ClassKind::VirtualMulitiInherit;
-        else if (rela.r_sym == pure)
-          pureset.insert(rela.offset);
-      }
+      if (std::ranges::count(typeinfoSymbols, 0u) || pureSymbol == 0)
+        throw std::runtime_error{"Failed to found vmi or si type info"};
+
+      if (!dumper.GetSection(".rela.dyn")) throw std::runtime_error{"Failed to load .rela.dyn section"};
+      relocations = elf::RelocationIndex{dumper};
+      std::cerr << "indexed " << relocations.size() << " relocations." << std::endl;
     }
 
     std::cerr << "create iterators..." << std::endl;
     auto pdb_iterator = pdb_dumper->GetIterator();
+    if (!pdb_iterator) throw std::runtime_error{"No symbol in pdb file"};
     auto elf_iterator = elf_dumper->GetIterator();
 
     initialDatabase();
@@ -398,14 +400,26 @@ struct DatabaseBuilder {
     std::cerr << "fill vtables from elf file..." << std::endl;
     fillVtables();
     std::cerr << "fill typeinfos from elf file..." << std::endl;
-    fillTypeinfos();
+    typeinfos.Finish();
+    fillTypeinfos(typeinfos, 2);
+    std::cerr << "fill class hierarchy closure..." << std::endl;
+    fillTypeinfoClosure(typeinfos, 2);
     std::cerr << "fill symbols from pdb file..." << std::endl;
     fillSymbols<&DatabaseBuilder::mssymbol, 1>(*pdb_iterator);
+    if (!exe.empty()) {
+      std::cerr << "fill vtables and typeinfos from exe file..." << std::endl;
+      fillWindowsRtti();
+    }
+    std::cerr << "fill scopes..." << std::endl;
+    fillScopes();
 
     sort();
+    exportIndex();
 
     std::cerr << "rebuild fts5 index..." << std::endl;
     sql("INSERT INTO fts_symbols(fts_symbols) VALUES('rebuild')");
+    std::cerr << "rebuild mangled name index..." << std::endl;
+    sql("INSERT INTO fts_raw(fts_raw) VALUES('rebuild')");
 
     std::cerr << "commit..." << std::endl;
     sql("COMMIT;");
@@ -422,30 +436,51 @@ struct DatabaseBuilder {
     sql("PRAGMA journal_mode = WAL;");
     sql("PRAGMA synchronous = NORMAL;");
     sql("PRAGMA temp_store = FILE;");
+    sql(std::format("PRAGMA user_version = {};", DatabaseVersion).c_str());
     sql("BEGIN;");
+    sql("DROP TABLE IF EXISTS fts_symbols_vocab;");
     sql("DROP TABLE IF EXISTS fts_symbols;");
+    sql("DROP TABLE IF EXISTS fts_raw;");
     sql("DROP TABLE IF EXISTS symbols;");
     sql("DROP TABLE IF EXISTS vtables;");
+    sql("DROP TABLE IF EXISTS vtable_headers;");
+    sql("DROP TABLE IF EXISTS vtable_offsets;");
     sql("DROP TABLE IF EXISTS typeinfos;");
     sql("DROP TABLE IF EXISTS typeinfo_defs;");
-    sql("CREATE TABLE typeinfos(key INTEGER PRIMARY KEY, type INTEGER, flags INTEGER);");
-    sql("CREATE TABLE typeinfo_defs(key INT, target INT, offset INT, flags INTEGER);");
-    sql("CREATE INDEX typeinfo_defs_index ON typeinfo_defs(key);");
-    sql("CREATE INDEX typeinfo_defs_target_index ON typeinfo_defs(target);");
-    sql("CREATE TABLE vtables(key INT, idx INT, target INT, PRIMARY KEY(key, idx));");
-    sql("CREATE TABLE symbols(key TEXT, raw TEXT, type INT, original INT, offset INT);");
+    sql("DROP TABLE IF EXISTS typeinfo_closure;");
+    sql("DROP TABLE IF EXISTS scopes;");
+    sql("CREATE TABLE scopes(id INTEGER PRIMARY KEY, parent INT, name TEXT, kind INT);");
+    sql("CREATE INDEX scope_parent_index ON scopes(parent, name);");
+    sql("CREATE TABLE typeinfos(original INT, key INT, type INTEGER, flags INTEGER, PRIMARY KEY(original, key));");
+    sql("CREATE TABLE typeinfo_defs(original INT, key INT, target INT, offset INT, flags INTEGER);");
+    sql("CREATE INDEX typeinfo_defs_index ON typeinfo_defs(original, key);");
+    sql("CREATE INDEX typeinfo_defs_target_index ON typeinfo_defs(original, target);");
+    sql("CREATE TABLE typeinfo_closure(original INT, ancestor INT, descendant INT, depth INT, offset INT);");
+    sql("CREATE INDEX typeinfo_closure_ancestor_index ON typeinfo_closure(original, ancestor, depth, descendant);");
+    sql("CREATE INDEX typeinfo_closure_descendant_index ON typeinfo_closure(original, descendant, depth, ancestor);");
+    sql("CREATE TABLE vtables"
+        "(original INT, key INT, sub INT, idx INT, target INT, PRIMARY KEY(original, key, sub, idx));");
+    sql("CREATE TABLE vtable_headers(original INT, key INT, sub INT, position INT, offset_to_top INT, typeinfo INT, "
+        "PRIMARY KEY(original, key, sub));");
+    sql("CREATE TABLE vtable_offsets"
+        "(original INT, key INT, sub INT, idx INT, value INT, PRIMARY KEY(original, key, sub, idx));");
+    sql("CREATE TABLE symbols(key TEXT, raw TEXT, type INT, original INT, offset INT, size INT, scope INT);");
     sql("CREATE VIRTUAL TABLE fts_symbols USING FTS5("
         "key, raw UNINDEXED, type UNINDEXED, original UNINDEXED, offset UNINDEXED, "
-        "content='symbols', tokenize='symbol');");
+        "content='symbols', tokenize='symbol initials fold');");
+    sql("CREATE VIRTUAL TABLE fts_symbols_vocab USING fts5vocab(fts_symbols, row);");
+    sql("CREATE VIRTUAL TABLE fts_raw USING FTS5(raw, content='symbols', tokenize='mangled');");
     sql("CREATE INDEX symbol_index ON symbols(key);");
     sql("CREATE INDEX symbol_offset_index ON symbols(offset);");
-    sql("CREATE TEMP TABLE symbols_unsorted (key TEXT, raw TEXT, type INT, original INT, offset INT);");
+    sql("CREATE INDEX symbol_scope_index ON symbols(scope);");
+    sql("CREATE TEMP TABLE symbols_unsorted "
+        "(key TEXT, raw TEXT, type INT, original INT, offset INT, size INT, scope INT);");
     sql("CREATE INDEX unsorted_symbol_index ON symbols_unsorted(key);");
 
     sqlerr{db} = sqlite3_prepare_v3(
-        db, "INSERT INTO symbols_unsorted VALUES (?, ?, ?, ?, ?);", -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr);
+        db, "INSERT INTO symbols_unsorted VALUES (?, ?, ?, ?, ?, ?, ?);", -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr);
     sqlerr{db} = sqlite3_prepare_v3(
-        db, "INSERT INTO vtables VALUES (?, ?, ?);", -1, SQLITE_PREPARE_PERSISTENT, &vtable_stmt, nullptr);
+        db, "INSERT INTO vtables VALUES (?, ?, ?, ?, ?);", -1, SQLITE_PREPARE_PERSISTENT, &vtable_stmt, nullptr);
   }
 
   void sort() {
@@ -455,6 +490,76 @@ struct DatabaseBuilder {
     sql("DROP TABLE symbols_unsorted;");
   }
 
+  void exportIndex() {
+    auto path = out;
+    path.replace_extension(".symidx");
+    std::cerr << "export symbol index to " << path << "..." << std::endl;
+    sqlite3_stmt *select{};
+    sqlerr{db} = sqlite3_prepare_v2(
+        db, "SELECT key, offset, size, type, original FROM symbols ORDER BY rowid;", -1, &select, nullptr);
+    std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)> guard{select, sqlite3_finalize};
+    symindex::Writer writer;
+    int res;
+    while ((res = sqlite3_step(select)) == SQLITE_ROW)
+      writer.Add(
+          {(char const *) sqlite3_column_text(select, 0), (size_t) sqlite3_column_bytes(select, 0)},
+          (uint64_t) sqlite3_column_int64(select, 1), (uint64_t) sqlite3_column_int64(select, 2),
+          (uint8_t) sqlite3_column_int(select, 3), (uint8_t) sqlite3_column_int(select, 4));
+    if (res != SQLITE_DONE) sqlerr{db} = res;
+    writer.Write(path);
+  }
+
+  int64_t internScope(int64_t parent, std::string name, ScopeKind kind) {
+    auto [it, inserted] = scopeIds.try_emplace({parent, std::move(name)}, (int64_t) scopes.size() + 1);
+    if (inserted)
+      scopes.push_back({parent, it->first.second, kind});
+    else if (auto &known = scopes[it->second - 1].kind; kind > known)
+      known = kind;
+    return it->second;
+  }
+
+  // interns the first count pieces of name, the last one as kind
+  int64_t internName(adapter::NameNode &name, size_t count, ScopeKind kind) {
+    int64_t parent = 0;
+    count          = std::min(count, name.Pieces.Elements.size());
+    for (size_t i = 0; i < count; i++)
+      parent = internScope(parent, name.Pieces.Elements[i]->ToString(), i + 1 == count ? kind : ScopeKind::Namespace);
+    return parent;
+  }
+
+  int64_t scopeOf(adapter::RootNode &root) {
+    if (auto fn = dynamic_cast<adapter::FunctionRootNode *>(&root))
+      return internName(*fn->Name, fn->Name->Pieces.Elements.size() - 1, ScopeKind::Namespace);
+    if (auto var = dynamic_cast<adapter::VariableRootNode *>(&root))
+      return internName(*var->Name, var->Name->Pieces.Elements.size() - 1, ScopeKind::Namespace);
+    if (auto sp = dynamic_cast<adapter::SpecialNameNode *>(&root)) {
+      // vtables and type infos live in the class they describe
+      if (auto type = dynamic_cast<adapter::SimpleType *>(sp->Type.get()))
+        return internName(*type->Name, type->Name->Pieces.Elements.size(), ScopeKind::Class);
+    } else if (auto local = dynamic_cast<adapter::LocalNameNode *>(&root)) {
+      if (auto fn = dynamic_cast<adapter::FunctionRootNode *>(local->Root.get()))
+        return internName(*fn->Name, fn->Name->Pieces.Elements.size(), ScopeKind::Function);
+      return scopeOf(*local->Root);
+    }
+    return 0;
+  }
+
+  void fillScopes() {
+    sqlite3_stmt *insert{};
+    sqlerr{db} = sqlite3_prepare_v2(db, "INSERT INTO scopes VALUES (?, ?, ?, ?);", -1, &insert, nullptr);
+    std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)> guard{insert, sqlite3_finalize};
+    for (size_t i = 0; i < scopes.size(); i++) {
+      auto &scope = scopes[i];
+      sqlerr{db}  = sqlite3_bind_int64(insert, 1, (int64_t) i + 1);
+      sqlerr{db}  = sqlite3_bind_int64(insert, 2, scope.parent);
+      sqlerr{db}  = sqlite3_bind_text(insert, 3, scope.name.c_str(), (int) scope.name.size(), SQLITE_STATIC);
+      sqlerr{db}  = sqlite3_bind_int(insert, 4, (int) scope.kind);
+      if (auto res = sqlite3_step(insert); res != SQLITE_DONE) sqlerr{db} = res;
+      sqlite3_reset(insert);
+    }
+    std::cerr << "filled " << scopes.size() << " scopes." << std::endl;
+  }
+
   bool mssymbol(common::Symbol const &sym, int &type) {
     llvm::ms_demangle::Demangler dem{};
     llvm::StringView sv{sym.Name.begin()._Ptr, sym.Name.end()._Ptr};
@@ -464,6 +569,7 @@ struct DatabaseBuilder {
     type     = (int) cvt->Kind;
     oss << *cvt;
     if (isSkiped()) return false;
+    scope = scopeOf(*cvt);
     return true;
   }
 
@@ -476,38 +582,37 @@ struct DatabaseBuilder {
     type     = (int) cvt->Kind;
     oss << *cvt;
     if (isSkiped()) return false;
+    scope = scopeOf(*cvt);
     if (auto sp = dynamic_cast<adapter::SpecialNameNode *>(cvt.get())) {
       if (sp->Kind == adapter::SpecialNameKind::vtable) {
-        auto start = (uint64_t *) rodata->GetMapped(sym.Offset);
-        if (start) {
-          auto step = start + 2;
-          while (*step || pureset.contains(rodata->GetOffset((char *) step))) step++;
-          vtables.insert_or_assign(sym.Offset, std::span{start + 2, step});
-        }
+        vtableSymbols.push_back({sym.Offset, sym.Size});
       } else if (sp->Kind == adapter::SpecialNameKind::type_info) {
-        if (auto classtype = relocmap.find(sym.Offset); classtype != relocmap.end()) {
-          auto start = (uint64_t *) rodata->GetMapped(sym.Offset);
+        if (auto classtype = typeinfoKindAt(sym.Offset)) {
+          auto range = image->GetRange(sym.Offset);
+          auto start = (uint64_t *) range.data();
+          auto words = range.size() / sizeof(uint64_t);
           start += 2; // skip type name
-          switch (classtype->second) {
-          case ClassKind::NoInherit: typeinfos.emplace(sym.Offset, std::make_unique<NoInheritClassTypeInfo>()); break;
-          case ClassKind::SingleInherit:
-            typeinfos.emplace(sym.Offset, std::make_unique<SingleInheritClassTypeInfo>(*start));
+          switch (*classtype) {
+          case TypeInfoGraph::NoInherit: typeinfos.Add(sym.Offset, TypeInfoGraph::NoInherit, 0, {}, {}); break;
+          case TypeInfoGraph::SingleInherit:
+            if (words < 3) break;
+            typeinfos.Add(sym.Offset, TypeInfoGraph::SingleInherit, 0, {start, 1}, {});
             break;
-          case ClassKind::VirtualMulitiInherit: {
-            auto temp = std::make_unique<VirtualMultiInheritClassTypeInfo>();
+          case TypeInfoGraph::VirtualMultiInherit: {
             struct _head {
               uint32_t flags;
               uint32_t count;
             } *head = (_head *) start;
+            if (words < 3 || (words - 3) / 2 < head->count) break;
             start++;
-            temp->flags = head->flags;
+            // __base_info is {__base_type, __offset_flags} pairs
+            vmiBases.clear();
+            vmiOffsetFlags.clear();
             for (uint32_t i = 0; i < head->count; i++) {
-              VirtualMultiInheritClassTypeInfo::ClassDesc desc;
-              desc.base         = *start++;
-              desc.offset_flags = *start++;
-              temp->bases.emplace_back(std::move(desc));
+              vmiBases.push_back(*start++);
+              vmiOffsetFlags.push_back((int64_t) *start++);
             }
-            typeinfos.emplace(sym.Offset, std::move(temp));
+            typeinfos.Add(sym.Offset, TypeInfoGraph::VirtualMultiInherit, head->flags, vmiBases, vmiOffsetFlags);
           } break;
           default: break;
           }
@@ -523,36 +628,240 @@ struct DatabaseBuilder {
            oss.str().starts_with("JsonUtil::") || oss.str().starts_with("(") || oss.str().starts_with("$SKIP");
   }
 
+  // type_info objects start with a pointer into the __cxxabiv1 vtable of their kind
+  std::optional<TypeInfoGraph::Kind> typeinfoKindAt(uint64_t offset) const {
+    auto reloc = relocations.Find(offset);
+    if (!reloc || reloc->type != elf::R_X86_64_64) return std::nullopt;
+    for (auto kind : {TypeInfoGraph::NoInherit, TypeInfoGraph::SingleInherit, TypeInfoGraph::VirtualMultiInherit})
+      if (reloc->symbol == typeinfoSymbols[kind]) return kind;
+    return std::nullopt;
+  }
+
+  // splits a vtable group into its vtables, stops at the symbol size or, when the size is unknown,
+  // after the functions of the primary vtable
+  std::vector<Vtable> decodeVtable(VtableSymbol const &sym) {
+    std::vector<Vtable> ret;
+    auto range = image->GetRange(sym.offset);
+    auto start = (uint64_t *) range.data();
+    size_t n   = range.size() / sizeof(uint64_t);
+    if (sym.size) n = std::min<size_t>(n, sym.size / sizeof(uint64_t));
+
+    struct Slot {
+      uint64_t value;
+      bool relocated, pure;
+    };
+    auto slot = [&](size_t i) {
+      auto reloc = relocations.Find(sym.offset + i * sizeof(uint64_t));
+      if (!reloc) return Slot{start[i], false, false};
+      auto pure = reloc->type == elf::R_X86_64_64 && reloc->symbol == pureSymbol;
+      return Slot{reloc->target ? reloc->target : start[i], true, pure};
+    };
+    auto isFunction = [&](Slot const &s) {
+      if (s.pure) return true;
+      return image->IsExecutable(s.value);
+    };
+    // type_info objects of this image are known, imported ones are relocated against their symbol
+    auto isTypeinfo = [&](Slot const &s) { return typeinfoKindAt(s.value) || (s.relocated && !isFunction(s)); };
+
+    size_t i = 0;
+    while (i < n) {
+      auto t = i;
+      while (t < n && !isTypeinfo(slot(t)) && !isFunction(slot(t))) t++;
+      if (t == i || t >= n || !isTypeinfo(slot(t))) break;
+      Vtable vtable{.position = (int) t + 1, .offsetToTop = (int64_t) slot(t - 1).value, .typeinfo = slot(t).value};
+      for (auto j = i; j + 1 < t; j++) vtable.offsets.push_back((int64_t) slot(j).value);
+      for (i = t + 1; i < n; i++) {
+        auto s = slot(i);
+        if (!isFunction(s)) break;
+        vtable.slots.push_back(s.pure ? 0 : s.value);
+      }
+      ret.emplace_back(std::move(vtable));
+      if (!sym.size) break;
+    }
+    return ret;
+  }
+
   void fillVtables() {
+    std::sort(vtableSymbols.begin(), vtableSymbols.end(), [](VtableSymbol const &a, VtableSymbol const &b) {
+      return a.offset < b.offset;
+    });
+    vtableSymbols.erase(
+        std::unique(
+            vtableSymbols.begin(), vtableSymbols.end(),
+            [](VtableSymbol const &a, VtableSymbol const &b) { return a.offset == b.offset; }),
+        vtableSymbols.end());
+
+    // every group is decoded on its own from the mapping
+    std::vector<std::vector<Vtable>> groups(vtableSymbols.size());
+    ParallelFor(vtableSymbols.size(), [&](unsigned, size_t first, size_t last) {
+      for (auto i = first; i < last; i++) groups[i] = decodeVtable(vtableSymbols[i]);
+    });
+    insertVtables(2, vtableSymbols, groups);
+  }
+
+  void insertVtables(int original, std::span<VtableSymbol const> keys, std::span<std::vector<Vtable> const> groups) {
     using namespace std::chrono_literals;
     stopwatch watch(2s, false);
-    for (auto &[k, v] : vtables) {
-      for (auto &a : v) {
-        auto idx   = &a - v.data();
-        sqlerr{db} = sqlite3_bind_int64(vtable_stmt, 1, (int64_t) k);
-        sqlerr{db} = sqlite3_bind_int(vtable_stmt, 2, (int) idx);
-        sqlerr{db} = sqlite3_bind_int64(vtable_stmt, 3, (int64_t) a);
-        if (auto res = sqlite3_step(vtable_stmt); res != SQLITE_DONE) sqlerr{db} = res;
-        sqlite3_reset(vtable_stmt);
-        sqlite3_clear_bindings(vtable_stmt);
+    sqlite3_stmt *header{}, *offset{};
+    sqlerr{db} = sqlite3_prepare_v2(db, "INSERT INTO vtable_headers VALUES (?, ?, ?, ?, ?, ?);", -1, &header, nullptr);
+    std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)> header_guard{header, sqlite3_finalize};
+    sqlerr{db} = sqlite3_prepare_v2(db, "INSERT INTO vtable_offsets VALUES (?, ?, ?, ?, ?);", -1, &offset, nullptr);
+    std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)> offset_guard{offset, sqlite3_finalize};
+    for (size_t g = 0; g < groups.size(); g++) {
+      auto key = (int64_t) keys[g].offset;
+      for (auto &vtable : groups[g]) {
+        auto sub   = (int) (&vtable - groups[g].data());
+        sqlerr{db} = sqlite3_bind_int(header, 1, original);
+        sqlerr{db} = sqlite3_bind_int64(header, 2, key);
+        sqlerr{db} = sqlite3_bind_int(header, 3, sub);
+        sqlerr{db} = sqlite3_bind_int(header, 4, vtable.position);
+        sqlerr{db} = sqlite3_bind_int64(header, 5, vtable.offsetToTop);
+        sqlerr{db} = sqlite3_bind_int64(header, 6, (int64_t) vtable.typeinfo);
+        if (auto res = sqlite3_step(header); res != SQLITE_DONE) sqlerr{db} = res;
+        sqlite3_reset(header);
+        for (auto &value : vtable.offsets) {
+          sqlerr{db} = sqlite3_bind_int(offset, 1, original);
+          sqlerr{db} = sqlite3_bind_int64(offset, 2, key);
+          sqlerr{db} = sqlite3_bind_int(offset, 3, sub);
+          sqlerr{db} = sqlite3_bind_int(offset, 4, (int) (&value - vtable.offsets.data()));
+          sqlerr{db} = sqlite3_bind_int64(offset, 5, value);
+          if (auto res = sqlite3_step(offset); res != SQLITE_DONE) sqlerr{db} = res;
+          sqlite3_reset(offset);
+        }
+        for (auto &a : vtable.slots) {
+          sqlerr{db} = sqlite3_bind_int(vtable_stmt, 1, original);
+          sqlerr{db} = sqlite3_bind_int64(vtable_stmt, 2, key);
+          sqlerr{db} = sqlite3_bind_int(vtable_stmt, 3, sub);
+          sqlerr{db} = sqlite3_bind_int(vtable_stmt, 4, (int) (&a - vtable.slots.data()));
+          sqlerr{db} = sqlite3_bind_int64(vtable_stmt, 5, (int64_t) a);
+          if (auto res = sqlite3_step(vtable_stmt); res != SQLITE_DONE) sqlerr{db} = res;
+          sqlite3_reset(vtable_stmt);
+          sqlite3_clear_bindings(vtable_stmt);
+        }
+        watch.add_count();
       }
-      watch.add_count();
     }
 
     std::cerr << "filled " << watch.get_count() << " vtable entry." << std::endl;
   }
 
-  void fillTypeinfos() {
+  void fillTypeinfoClosure(TypeInfoGraph const &graph, int original) {
     using namespace std::chrono_literals;
     stopwatch watch(2s, false);
-    ClassTypeInfo::FillContext ctx{db};
-    for (auto &[k, v] : typeinfos) {
-      v->Fill(k, ctx);
+    // the graph is read only from here, walk it on every core and only serialize the inserts
+    std::vector<std::vector<TypeInfoGraph::Ancestor>> closure(graph.size());
+    ParallelFor(graph.size(), [&](unsigned, size_t first, size_t last) {
+      for (auto i = first; i < last; i++) closure[i] = graph.AncestorsOf(i);
+    });
+
+    sqlite3_stmt *insert{};
+    sqlerr{db} = sqlite3_prepare_v2(db, "INSERT INTO typeinfo_closure VALUES (?, ?, ?, ?, ?);", -1, &insert, nullptr);
+    std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)> guard{insert, sqlite3_finalize};
+    for (uint32_t i = 0; i < graph.size(); i++) {
+      for (auto &ancestor : closure[i]) {
+        sqlerr{db} = sqlite3_bind_int(insert, 1, original);
+        sqlerr{db} = sqlite3_bind_int64(insert, 2, (int64_t) ancestor.key);
+        sqlerr{db} = sqlite3_bind_int64(insert, 3, (int64_t) graph.KeyOf(i));
+        sqlerr{db} = sqlite3_bind_int(insert, 4, ancestor.depth);
+        if (ancestor.offset)
+          sqlerr{db} = sqlite3_bind_int64(insert, 5, *ancestor.offset);
+        else
+          sqlerr{db} = sqlite3_bind_null(insert, 5);
+        if (auto res = sqlite3_step(insert); res != SQLITE_DONE) sqlerr{db} = res;
+        sqlite3_reset(insert);
+        watch.add_count();
+      }
+    }
+    std::cerr << "filled " << watch.get_count() << " closure entry." << std::endl;
+  }
+
+  void fillTypeinfos(TypeInfoGraph const &graph, int original) {
+    using namespace std::chrono_literals;
+    stopwatch watch(2s, false);
+    sqlite3_stmt *root{}, *child{};
+    sqlerr{db} = sqlite3_prepare_v2(db, "INSERT INTO typeinfos VALUES(?, ?, ?, ?);", -1, &root, nullptr);
+    std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)> root_guard{root, sqlite3_finalize};
+    sqlerr{db} = sqlite3_prepare_v2(db, "INSERT INTO typeinfo_defs VALUES(?, ?, ?, ?, ?);", -1, &child, nullptr);
+    std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)> child_guard{child, sqlite3_finalize};
+    for (uint32_t i = 0; i < graph.size(); i++) {
+      auto key   = graph.KeyOf(i);
+      sqlerr{db} = sqlite3_bind_int(root, 1, original);
+      sqlerr{db} = sqlite3_bind_int64(root, 2, (int64_t) key);
+      sqlerr{db} = sqlite3_bind_int(root, 3, graph.KindOf(i));
+      sqlerr{db} = sqlite3_bind_int64(root, 4, graph.FlagsOf(i));
+      if (auto res = sqlite3_step(root); res != SQLITE_DONE) sqlerr{db} = res;
+      sqlite3_reset(root);
+      auto bases = graph.BasesOf(i);
+      auto flags = graph.OffsetFlagsOf(i);
+      for (size_t j = 0; j < bases.size(); j++) {
+        sqlerr{db} = sqlite3_bind_int(child, 1, original);
+        sqlerr{db} = sqlite3_bind_int64(child, 2, (int64_t) key);
+        sqlerr{db} = sqlite3_bind_int64(child, 3, (int64_t) bases[j]);
+        sqlerr{db} = sqlite3_bind_int64(child, 4, flags[j] >> 8);
+        sqlerr{db} = sqlite3_bind_int(child, 5, (int) (flags[j] & 0xFF));
+        if (auto res = sqlite3_step(child); res != SQLITE_DONE) sqlerr{db} = res;
+        sqlite3_reset(child);
+      }
       watch.add_count();
     }
     std::cerr << "filled " << watch.get_count() << " type_info entry." << std::endl;
   }
 
+  // the pdb symbols are keyed by rva, the entry point of the exe is a frame every build can be checked against
+  void checkWindowsOffsets(pe::Image const &image) {
+    sqlite3_stmt *select{};
+    sqlerr{db} = sqlite3_prepare_v2(
+        db, "SELECT key FROM symbols_unsorted WHERE original = 1 AND offset = ? LIMIT 1;", -1, &select, nullptr);
+    std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)> guard{select, sqlite3_finalize};
+    sqlerr{db} = sqlite3_bind_int64(select, 1, image.EntryPoint());
+    if (auto res = sqlite3_step(select); res == SQLITE_ROW)
+      std::cerr << "entry point " << std::hex << image.EntryPoint() << std::dec << " resolves to "
+                << (char const *) sqlite3_column_text(select, 0) << "." << std::endl;
+    else if (res == SQLITE_DONE)
+      std::cerr << "warning: no windows symbol at the entry point, the pdb does not match the exe." << std::endl;
+    else
+      sqlerr{db} = res;
+  }
+
+  // msvc rtti of the exe, keyed like the pdb symbols by rva
+  void fillWindowsRtti() {
+    pe::Image image{exe};
+    checkWindowsOffsets(image);
+    auto rtti     = pe::ScanRtti(image);
+    auto offsetOf = [](uint32_t rva) { return (uint64_t) rva; };
+
+    std::vector<VtableSymbol> keys;
+    std::vector<std::vector<Vtable>> groups;
+    for (auto &vftable : rtti.vtables) {
+      keys.push_back({offsetOf(vftable.address), vftable.slots.size() * sizeof(uint64_t)});
+      Vtable vtable{
+          .position = 0, .offsetToTop = -(int64_t) vftable.offset, .typeinfo = offsetOf(vftable.typeDescriptor)};
+      for (auto slot : vftable.slots) vtable.slots.push_back(offsetOf(slot));
+      groups.emplace_back().emplace_back(std::move(vtable));
+    }
+    insertVtables(1, keys, groups);
+
+    TypeInfoGraph graph;
+    std::vector<uint64_t> bases;
+    std::vector<int64_t> offsetFlags;
+    for (auto &cls : rtti.classes) {
+      bases.clear();
+      offsetFlags.clear();
+      for (auto &base : cls.bases) {
+        bases.push_back(offsetOf(base.typeDescriptor));
+        // same layout as __offset_flags, __virtual_mask 1 and __public_mask 2 (BCD_PRIVORPROTBASE is 4)
+        offsetFlags.push_back((int64_t) base.mdisp << 8 | (base.pdisp >= 0 ? 1 : 0) | (base.attributes & 4 ? 0 : 2));
+      }
+      auto kind = bases.empty()                                ? TypeInfoGraph::NoInherit
+                  : bases.size() == 1 && offsetFlags[0] == 2 ? TypeInfoGraph::SingleInherit
+                                                               : TypeInfoGraph::VirtualMultiInherit;
+      graph.Add(offsetOf(cls.typeDescriptor), kind, cls.attributes, bases, offsetFlags);
+    }
+    graph.Finish();
+    fillTypeinfos(graph, 1);
+    fillTypeinfoClosure(graph, 1);
+  }
+
   template <bool (DatabaseBuilder::*Decoder)(common::Symbol const &sym, int &type), int original>
   void fillSymbols(common::ISymbolIterator &it) {
     using namespace std::chrono_literals;
@@ -573,6 +882,8 @@ struct DatabaseBuilder {
       sqlerr{db} = sqlite3_bind_int(stmt, 3, type);
       sqlerr{db} = sqlite3_bind_int(stmt, 4, original);
       sqlerr{db} = sqlite3_bind_int64(stmt, 5, symbol.Offset);
+      sqlerr{db} = sqlite3_bind_int64(stmt, 6, symbol.Size);
+      if (scope) sqlerr{db} = sqlite3_bind_int64(stmt, 7, scope);
       if (auto res = sqlite3_step(stmt); res != SQLITE_DONE) sqlerr{db} = res;
       sqlite3_reset(stmt);
       sqlite3_clear_bindings(stmt);
@@ -584,8 +895,755 @@ struct DatabaseBuilder {
 };
 
 extern "C" __declspec(dllexport) void buildDatabase(
-    std::filesystem::path const &out, std::filesystem::path const &pdb, std::filesystem::path const &elf) {
-  DatabaseBuilder{out, pdb, elf}();
+    std::filesystem::path const &out, std::filesystem::path const &pdb, std::filesystem::path const &elf,
+    std::filesystem::path const &exe = {}) {
+  DatabaseBuilder{out, pdb, elf, exe}();
+}
+
+// Appends one release database to a database holding every release. A symbol is stored once in symbols (and once
+// in the fts tables), symbol_ranges keeps the runs of consecutive versions it is part of and symbol_offsets the runs
+// of consecutive versions it kept the same offset and size in, so an unchanged symbol costs one row for all releases.
+// Releases are expected to be merged in order.
+// Only symbols are merged, scopes, typeinfos, typeinfo_defs, typeinfo_closure, vtables, vtable_headers and
+// vtable_offsets stay in the release databases. fts_symbols has no offset column and its rowids are interning order,
+// not key order, so the browser refuses merged databases.
+struct ReleaseMerger {
+  std::filesystem::path const &out;
+  std::wstring const &version;
+  std::filesystem::path const &source;
+  sqlite3 *db{};
+  char *errmsg{};
+
+  ReleaseMerger(ReleaseMerger const &) = delete;
+
+  ReleaseMerger(std::filesystem::path const &out, std::wstring const &version, std::filesystem::path const &source)
+      : out(out), version(version), source(source) {}
+
+  ~ReleaseMerger() {
+    if (db) sqlerr{db} = sqlite3_close(db);
+  }
+
+  void operator()() {
+    {
+      std::ifstream ifs{source};
+      if (!ifs || detectFileType(ifs) != FileType::DatabaseFile) throw std::runtime_error{"Expect a release database."};
+    }
+    std::cerr << "open database..." << std::endl;
+    sqlerr{db} = sqlite3_open16((void const *) out.c_str(), &db);
+    sql("PRAGMA journal_mode = WAL;");
+    sql("PRAGMA synchronous = NORMAL;");
+    sql("PRAGMA temp_store = FILE;");
+    initialDatabase();
+    if (scalar("SELECT count(*) FROM pragma_table_info('symbol_offsets') WHERE name = 'version';"))
+      throw std::runtime_error{"Merged database keeps an offset per version, merge the releases into a new one."};
+    run("ATTACH ? AS source;", source.wstring());
+    if (scalar("SELECT count(*) FROM source.sqlite_master WHERE name = 'versions';"))
+      throw std::runtime_error{"Expect a release database, not a merged one."};
+    checkDatabaseVersion(db, "source");
+    if (scalar("SELECT count(*) FROM versions WHERE name = ?;", version))
+      throw std::runtime_error{"Version already merged."};
+
+    sql("BEGIN;");
+    try {
+      merge();
+    } catch (...) {
+      sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+      throw;
+    }
+    std::cerr << "commit..." << std::endl;
+    sql("COMMIT;");
+    sql("DETACH source;");
+  }
+
+  void merge() {
+    auto previous = scalar("SELECT ifnull(max(id), 0) FROM versions;");
+    auto interned = scalar("SELECT ifnull(max(id), 0) FROM symbols;");
+    run("INSERT INTO versions(name) VALUES (?);", version);
+    auto current = sqlite3_last_insert_rowid(db);
+
+    std::cerr << "intern symbols..." << std::endl;
+    run("INSERT OR IGNORE INTO symbols(key, raw, type, original) "
+        "SELECT key, raw, type, original FROM source.symbols ORDER BY key;");
+    std::cerr << "interned " << scalar("SELECT ifnull(max(id), 0) FROM symbols;") - interned << " new symbols."
+              << std::endl;
+    std::cerr << "fill offsets..." << std::endl;
+    sql("CREATE TEMP TABLE release_offsets(symbol INT, offset INT, size INT, PRIMARY KEY(symbol, offset)) "
+        "WITHOUT ROWID;");
+    run("INSERT OR IGNORE INTO temp.release_offsets(symbol, offset, size) "
+        "SELECT S.id, R.offset, R.size FROM source.symbols R JOIN symbols S ON S.original = R.original AND "
+        "S.raw = R.raw;");
+    // like the version ranges below, an unchanged offset extends its run and a moved or resized one opens a new one
+    run("UPDATE symbol_offsets SET last = ?2 WHERE last = ?1 AND EXISTS (SELECT 1 FROM temp.release_offsets R "
+        "WHERE R.symbol = symbol_offsets.symbol AND R.offset = symbol_offsets.offset AND "
+        "R.size = symbol_offsets.size);",
+        previous, current);
+    run("INSERT INTO symbol_offsets(symbol, offset, size, first, last) "
+        "SELECT symbol, offset, size, ?1, ?1 FROM temp.release_offsets R WHERE NOT EXISTS (SELECT 1 FROM "
+        "symbol_offsets O WHERE O.last = ?1 AND O.symbol = R.symbol AND O.offset = R.offset);",
+        current);
+    std::cerr << "fill version ranges..." << std::endl;
+    // the symbols still there extend the range ending at the previous version, the others open a new one
+    run("UPDATE symbol_ranges SET last = ?2 WHERE last = ?1 AND symbol IN (SELECT symbol FROM temp.release_offsets);",
+        previous, current);
+    run("INSERT INTO symbol_ranges(symbol, first, last) "
+        "SELECT DISTINCT symbol, ?1, ?1 FROM temp.release_offsets WHERE symbol NOT IN "
+        "(SELECT symbol FROM symbol_ranges WHERE last = ?1);",
+        current);
+    sql("DROP TABLE temp.release_offsets;");
+    std::cerr << "index new symbols..." << std::endl;
+    run("INSERT INTO fts_symbols(rowid, key, raw, type, original) "
+        "SELECT id, key, raw, type, original FROM symbols WHERE id > ?;",
+        interned);
+    run("INSERT INTO fts_raw(rowid, raw) SELECT id, raw FROM symbols WHERE id > ?;", interned);
+  }
+
+  void sql(char const *sql) { sqlerr{db, &errmsg} = sqlite3_exec(db, sql, nullptr, nullptr, &errmsg); }
+
+  void bind(sqlite3_stmt *stmt, int idx, int64_t value) { sqlerr{db} = sqlite3_bind_int64(stmt, idx, value); }
+  void bind(sqlite3_stmt *stmt, int idx, std::wstring const &value) {
+    sqlerr{db} = sqlite3_bind_text16(
+        stmt, idx, value.c_str(), (int) (value.size() * sizeof(wchar_t)), SQLITE_TRANSIENT);
+  }
+
+  template <typename... Args> sqlite3_stmt *prepare(char const *text, Args const &...args) {
+    sqlite3_stmt *stmt{};
+    sqlerr{db} = sqlite3_prepare_v2(db, text, -1, &stmt, nullptr);
+    int idx = 0;
+    (bind(stmt, ++idx, args), ...);
+    return stmt;
+  }
+
+  template <typename... Args> void run(char const *text, Args const &...args) {
+    std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)> stmt{prepare(text, args...), sqlite3_finalize};
+    if (auto res = sqlite3_step(stmt.get()); res != SQLITE_DONE) sqlerr{db} = res;
+  }
+
+  template <typename... Args> int64_t scalar(char const *text, Args const &...args) {
+    std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)> stmt{prepare(text, args...), sqlite3_finalize};
+    if (auto res = sqlite3_step(stmt.get()); res != SQLITE_ROW) sqlerr{db} = res;
+    return sqlite3_column_int64(stmt.get(), 0);
+  }
+
+  void initialDatabase() {
+    sql("CREATE TABLE IF NOT EXISTS versions(id INTEGER PRIMARY KEY, name TEXT UNIQUE);");
+    sql("CREATE TABLE IF NOT EXISTS symbols"
+        "(id INTEGER PRIMARY KEY, key TEXT, raw TEXT, type INT, original INT, UNIQUE(original, raw));");
+    sql("CREATE INDEX IF NOT EXISTS symbol_index ON symbols(key);");
+    sql("CREATE TABLE IF NOT EXISTS symbol_ranges"
+        "(symbol INT, first INT, last INT, PRIMARY KEY(symbol, first)) WITHOUT ROWID;");
+    sql("CREATE INDEX IF NOT EXISTS symbol_ranges_first_index ON symbol_ranges(first, symbol);");
+    sql("CREATE INDEX IF NOT EXISTS symbol_ranges_last_index ON symbol_ranges(last, symbol);");
+    sql("CREATE TABLE IF NOT EXISTS symbol_offsets"
+        "(symbol INT, offset INT, size INT, first INT, last INT, PRIMARY KEY(symbol, offset, first)) WITHOUT ROWID;");
+    sql("CREATE INDEX IF NOT EXISTS symbol_offsets_offset_index ON symbol_offsets(offset, first);");
+    sql("CREATE INDEX IF NOT EXISTS symbol_offsets_last_index ON symbol_offsets(last, symbol, offset);");
+    sql("CREATE VIRTUAL TABLE IF NOT EXISTS fts_symbols USING FTS5("
+        "key, raw UNINDEXED, type UNINDEXED, original UNINDEXED, "
+        "content='symbols', content_rowid='id', tokenize='symbol initials fold');");
+    sql("CREATE VIRTUAL TABLE IF NOT EXISTS fts_raw USING FTS5("
+        "raw, content='symbols', content_rowid='id', tokenize='mangled');");
+  }
+};
+
+extern "C" __declspec(dllexport) void mergeDatabase(
+    std::filesystem::path const &out, std::wstring const &version, std::filesystem::path const &source) {
+  ReleaseMerger{out, version, source}();
+}
+
+AddressTable loadAddressTable(sqlite3 *db, int original) {
+  sqlite3_stmt *stmt{};
+  sqlerr{db} = sqlite3_prepare_v2(db, "SELECT offset, size, key FROM symbols WHERE original = ?;", -1, &stmt, nullptr);
+  std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)> guard{stmt, sqlite3_finalize};
+  sqlerr{db} = sqlite3_bind_int(stmt, 1, original);
+  std::vector<AddressTable::Entry> entries;
+  int res;
+  while ((res = sqlite3_step(stmt)) == SQLITE_ROW)
+    entries.emplace_back(
+        (uint64_t) sqlite3_column_int64(stmt, 0), (uint64_t) sqlite3_column_int64(stmt, 1),
+        std::string{(char const *) sqlite3_column_text(stmt, 2), (size_t) sqlite3_column_bytes(stmt, 2)});
+  if (res != SQLITE_DONE) sqlerr{db} = res;
+  return AddressTable{std::move(entries)};
+}
+
+// reads one hex offset per line, prints `offset name+delta`, or `offset ??` when nothing covers it
+template <typename Resolve> void symbolizeLoop(Resolve &&resolve) {
+  std::ios::sync_with_stdio(false);
+  std::string line, out;
+  while (std::getline(std::cin, line)) {
+    auto first = line.data(), last = line.data() + line.size();
+    while (first != last && (*first == ' ' || *first == '\t')) first++;
+    if (last - first > 2 && first[0] == '0' && (first[1] == 'x' || first[1] == 'X')) first += 2;
+    uint64_t address;
+    if (std::from_chars(first, last, address, 16).ec != std::errc{}) continue;
+    out.clear();
+    std::format_to(std::back_inserter(out), "{:#x} ", address);
+    if (!resolve(address, out)) out += "??";
+    out += '\n';
+    std::cout << out;
+  }
+}
+
+void symbolize(std::filesystem::path const &source, wchar_t const *originalName) {
+  int original;
+  if (_wcsicmp(originalName, L"windows") == 0)
+    original = 1;
+  else if (_wcsicmp(originalName, L"linux") == 0)
+    original = 2;
+  else
+    throw std::runtime_error{"Unknown original, expect windows or linux"};
+
+  std::ifstream ifs{source, std::ios::binary};
+  if (!ifs) throw std::runtime_error{"Failed to open file"};
+  auto type = detectFileType(ifs);
+  ifs.close();
+
+  if (type == FileType::IndexFile) {
+    symindex::Reader index{source};
+    if (!index.Verify()) throw std::runtime_error{"Corrupted symbol index"};
+    symbolizeLoop([&](uint64_t address, std::string &out) {
+      auto hit = index.Symbolize((uint8_t) original, address);
+      if (!hit) return false;
+      std::format_to(std::back_inserter(out), "{}+{:#x}", index.Name(hit->id), hit->delta);
+      return true;
+    });
+    return;
+  }
+  if (type != FileType::DatabaseFile) throw std::runtime_error{"Unknown source file, expect a database or an index."};
+
+  sqlite3 *db{};
+  sqlerr{db} = sqlite3_open_v2((char const *) source.u8string().c_str(), &db, SQLITE_OPEN_READONLY, nullptr);
+  std::unique_ptr<sqlite3, decltype(&sqlite3_close)> guard{db, sqlite3_close};
+  checkDatabaseVersion(db);
+  auto table = loadAddressTable(db, original);
+  std::cerr << "loaded " << table.size() << " symbols." << std::endl;
+  symbolizeLoop([&](uint64_t address, std::string &out) {
+    auto entry = table.find(address);
+    if (!entry) return false;
+    std::format_to(std::back_inserter(out), "{}+{:#x}", entry->name, address - entry->offset);
+    return true;
+  });
+}
+
+// Resolves module+offset frames against a database or a single elf.
+// Address tables are loaded the first time a module is seen and shared by all workers.
+class FrameSymbolizer {
+public:
+  struct Module {
+    AddressTable table;
+    bool mangled; // names come straight from the elf and still need the adapter printer
+  };
+
+  FrameSymbolizer(std::filesystem::path const &source) : source(source) {
+    std::ifstream ifs{source, std::ios::binary};
+    if (!ifs) throw std::runtime_error{"Failed to open file"};
+    type = detectFileType(ifs);
+    if (type == FileType::DatabaseFile) {
+      sqlerr{db} = sqlite3_open_v2((char const *) source.u8string().c_str(), &db, SQLITE_OPEN_READONLY, nullptr);
+      checkDatabaseVersion(db);
+    } else if (type != FileType::ElfFile)
+      throw std::runtime_error{"Unknown source file, expect a database or an elf."};
+  }
+
+  ~FrameSymbolizer() {
+    if (db) sqlite3_close(db);
+  }
+
+  bool isDatabase() const { return type == FileType::DatabaseFile; }
+
+  Module const *get(std::string_view name) {
+    std::lock_guard lock{mtx};
+    if (auto it = cache.find(name); it != cache.end()) return it->second;
+    return cache.emplace(std::string{name}, load(name)).first->second;
+  }
+
+  // appends each line with ` (name+0xdelta)` after every frame that resolves
+  void resolve(std::span<std::string const> lines, std::string &out) {
+    std::string_view lastName;
+    Module const *last = nullptr;
+    std::unordered_map<AddressTable::Entry const *, std::string> decoded;
+    for (auto &line : lines) {
+      size_t pos = 0, plus;
+      while ((plus = line.find("+0x", pos)) != std::string::npos) {
+        auto start = plus;
+        while (start > pos && !isspace((unsigned char) line[start - 1]) && !strchr("([\"'", line[start - 1])) start--;
+        uint64_t offset;
+        auto [end, ec] = std::from_chars(line.data() + plus + 3, line.data() + line.size(), offset, 16);
+        auto next      = (size_t) (end - line.data());
+        out.append(line, pos, next - pos);
+        pos = next;
+        if (ec != std::errc{} || start == plus) continue;
+
+        std::string_view name{line.data() + start, plus - start};
+        if (name != lastName) {
+          last     = get(name);
+          lastName = name;
+        }
+        if (!last) continue;
+        if (auto entry = last->table.find(offset)) {
+          out += " (";
+          if (last->mangled) {
+            auto it = decoded.find(entry);
+            if (it == decoded.end()) it = decoded.emplace(entry, decodeElf(entry->name)).first;
+            out += it->second;
+          } else
+            out += entry->name;
+          std::format_to(std::back_inserter(out), "+{:#x})", offset - entry->offset);
+        }
+      }
+      out.append(line, pos);
+      out += '\n';
+    }
+  }
+
+private:
+  std::filesystem::path source;
+  FileType type;
+  sqlite3 *db{};
+  std::mutex mtx;
+  std::vector<std::unique_ptr<Module>> modules;
+  std::map<std::string, Module const *, std::less<>> cache;
+  Module const *byOriginal[2]{};
+
+  Module const *load(std::string_view name) {
+    std::filesystem::path path{name};
+    if (type == FileType::ElfFile) {
+      if (_wcsicmp(path.filename().c_str(), source.filename().c_str()) != 0) return nullptr;
+      std::vector<AddressTable::Entry> entries;
+      auto dumper = elf::GetDumper().Open(source);
+      auto it     = dumper->GetIterator();
+      if (!it) throw std::runtime_error{"Failed to load .dynsym section"};
+      do {
+        auto sym = it->Get();
+        if (sym.Offset) entries.emplace_back(sym.Offset, sym.Size, std::move(sym.Name));
+      } while (it->Next());
+      std::cerr << "loaded " << entries.size() << " symbols from " << source << "." << std::endl;
+      return modules.emplace_back(new Module{AddressTable{std::move(entries)}, true}).get();
+    }
+    auto ext      = path.extension();
+    auto original = _wcsicmp(ext.c_str(), L".exe") == 0 || _wcsicmp(ext.c_str(), L".dll") == 0 ? 1 : 2;
+    auto &slot    = byOriginal[original - 1];
+    if (!slot) {
+      slot = modules.emplace_back(new Module{loadAddressTable(db, original), false}).get();
+      std::cerr << "loaded " << slot->table.size() << " symbols for " << (original == 1 ? "windows" : "linux")
+                << "." << std::endl;
+    }
+    return slot;
+  }
+};
+
+void symbolizeFrames(std::filesystem::path const &source, std::istream &in) {
+  FrameSymbolizer symbolizer{source};
+  auto workers = std::max(1u, std::thread::hardware_concurrency());
+  TaskPool pool{workers};
+  std::vector<std::string> lines, outs(workers);
+  constexpr size_t batch = 1 << 16;
+
+  std::ios::sync_with_stdio(false);
+  std::string line;
+  while (true) {
+    lines.clear();
+    while (lines.size() < batch && std::getline(in, line)) lines.emplace_back(std::move(line));
+    if (lines.empty()) break;
+    pool.ParallelFor(lines.size(), [&](unsigned slice, size_t first, size_t last) {
+      outs[slice].clear();
+      symbolizer.resolve({lines.data() + first, lines.data() + last}, outs[slice]);
+    });
+    for (auto &out : outs) std::cout << out;
+  }
+  std::cout.flush();
+}
+
+void symbolizeFrames(std::filesystem::path const &source, std::filesystem::path const &input) {
+  std::ifstream ifs{input};
+  if (!ifs) throw std::runtime_error{"Failed to open file"};
+  symbolizeFrames(source, ifs);
+}
+
+// Keeps the source resident and answers requests over a unix domain socket.
+// Every message in both directions is a little endian uint32 length followed by that many bytes.
+// Requests are `<command> <argument>`:
+//   decode <symbol>           simple form
+//   decode-original <symbol>  original form
+//   symbolize <lines>         module+0xOFFSET frames, same output as symbolize-frames
+//   search <fts5 query>       up to 100 `original offset key` lines (database source only)
+//   shutdown                  stop accepting, close the open sessions and return from serve
+// Replies start with `ok\n` or `error\n`, followed by the result or the message.
+// A request longer than MaxRequest is answered with an error and its connection closed.
+class SymbolServer {
+  static constexpr uint32_t MaxRequest = 16 << 20;
+
+  using Connection = std::unique_ptr<sqlite3, decltype(&sqlite3_close)>;
+
+  std::filesystem::path source;
+  FrameSymbolizer symbolizer;
+
+  std::mutex mtx;
+  std::condition_variable idle;
+  std::unordered_set<SOCKET> clients;
+  SOCKET listener = INVALID_SOCKET;
+
+  static bool readAll(SOCKET client, char *data, size_t size) {
+    while (size) {
+      auto got = recv(client, data, (int) std::min<size_t>(size, INT_MAX), 0);
+      if (got <= 0) return false;
+      data += got;
+      size -= got;
+    }
+    return true;
+  }
+
+  static bool writeAll(SOCKET client, char const *data, size_t size) {
+    while (size) {
+      auto sent = send(client, data, (int) std::min<size_t>(size, INT_MAX), 0);
+      if (sent <= 0) return false;
+      data += sent;
+      size -= sent;
+    }
+    return true;
+  }
+
+  // every session keeps its own read only connection, so the page cache stays warm between its requests
+  sqlite3 *connection(Connection &conn) {
+    if (!conn) {
+      sqlite3 *db{};
+      auto rc = sqlite3_open_v2((char const *) source.u8string().c_str(), &db, SQLITE_OPEN_READONLY, nullptr);
+      conn.reset(db);
+      sqlerr{db} = rc;
+    }
+    return conn.get();
+  }
+
+  std::string search(std::string const &query, Connection &conn) {
+    if (!symbolizer.isDatabase()) throw std::runtime_error{"search needs a database source"};
+    auto db = connection(conn);
+    sqlite3_stmt *stmt{};
+    sqlerr{db} = sqlite3_prepare_v2(
+        db, "SELECT original, offset, key FROM fts_symbols(?) ORDER BY rowid LIMIT 100;", -1, &stmt, nullptr);
+    std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)> guard{stmt, sqlite3_finalize};
+    sqlerr{db} = sqlite3_bind_text(stmt, 1, query.c_str(), (int) query.size(), SQLITE_STATIC);
+    std::string out;
+    int res;
+    while ((res = sqlite3_step(stmt)) == SQLITE_ROW)
+      std::format_to(
+          std::back_inserter(out), "{} {:#x} {}\n", sqlite3_column_int(stmt, 0), sqlite3_column_int64(stmt, 1),
+          (char const *) sqlite3_column_text(stmt, 2));
+    if (res != SQLITE_DONE) sqlerr{db} = res;
+    return out;
+  }
+
+  std::string handle(std::string const &request, Connection &conn) {
+    auto space    = request.find(' ');
+    auto command  = std::string_view{request}.substr(0, space);
+    auto argument = space == std::string::npos ? std::string{} : request.substr(space + 1);
+    if (command == "decode" || command == "decode-original") {
+      if (argument.empty()) return {};
+      return decodeSymbol(argument, command == "decode" ? DecodeMode::Simple : DecodeMode::Original);
+    } else if (command == "symbolize") {
+      std::vector<std::string> lines;
+      std::istringstream iss{argument};
+      for (std::string line; std::getline(iss, line);) lines.emplace_back(std::move(line));
+      std::string out;
+      symbolizer.resolve(lines, out);
+      return out;
+    } else if (command == "search") {
+      return search(argument, conn);
+    } else if (command == "shutdown") {
+      // session stops the server once the reply is out
+      return {};
+    }
+    throw std::runtime_error{"Unknown command " + std::string{command}};
+  }
+
+  void session(SOCKET client) {
+    Connection conn{nullptr, sqlite3_close};
+    std::string request, reply;
+    uint32_t size;
+    while (readAll(client, (char *) &size, sizeof size)) {
+      auto oversized = size > MaxRequest;
+      if (oversized)
+        reply = std::format("error\nrequest of {} bytes exceeds the limit of {}", size, MaxRequest);
+      else {
+        request.resize(size);
+        if (!readAll(client, request.data(), size)) break;
+        try {
+          reply = "ok\n" + handle(request, conn);
+        } catch (std::exception const &e) { reply = std::string{"error\n"} + e.what(); }
+      }
+      size = (uint32_t) reply.size();
+      if (!writeAll(client, (char const *) &size, sizeof size) || !writeAll(client, reply.data(), reply.size())) break;
+      // the unread payload leaves the stream out of sync, so the connection cannot continue
+      if (oversized) break;
+      if (request == "shutdown") stop();
+    }
+    // run may tear the server down right after the notify, so the connection has to be closed by then
+    conn.reset();
+    std::lock_guard lock{mtx};
+    clients.erase(client);
+    closesocket(client);
+    idle.notify_all();
+  }
+
+public:
+  SymbolServer(std::filesystem::path const &source) : source(source), symbolizer(source) {}
+
+  // Accepts until stop() closes the listener. Every connection gets its own thread, so an idle client never holds
+  // back the others, and the shared state above is all a session touches.
+  void run(SOCKET socket) {
+    {
+      std::lock_guard lock{mtx};
+      listener = socket;
+    }
+    SOCKET client;
+    while ((client = accept(socket, nullptr, nullptr)) != INVALID_SOCKET) {
+      std::lock_guard lock{mtx};
+      if (listener == INVALID_SOCKET) {
+        closesocket(client);
+        break;
+      }
+      clients.insert(client);
+      std::thread{[this, client] { session(client); }}.detach();
+    }
+    stop();
+    // wake the sessions blocked in recv and wait until they are gone, they reference this server
+    std::unique_lock lock{mtx};
+    for (auto client : clients) ::shutdown(client, SD_BOTH);
+    idle.wait(lock, [this] { return clients.empty(); });
+  }
+
+  void stop() {
+    std::lock_guard lock{mtx};
+    if (listener == INVALID_SOCKET) return;
+    closesocket(listener);
+    listener = INVALID_SOCKET;
+  }
+};
+
+// symbols of one binary keyed by their decoded name, with the virtual functions of its vtables for elf and pe
+struct DiffImage {
+  struct Entry {
+    std::string key, raw;
+    uint64_t offset, size;
+  };
+  struct Layout {
+    std::string key;
+    std::vector<std::string> slots; // decoded targets, in vtable group order
+  };
+  std::vector<Entry> symbols; // sorted by key
+  std::vector<Layout> vtables; // sorted by key
+};
+
+// the function slots of every sized vtable symbol, offset to top and type_info words are left out
+std::vector<DiffImage::Layout> readElfVtables(elf::IElfDumpSource &source, std::span<DiffImage::Entry const> symbols) {
+  auto image = source.GetAddressSpace();
+  elf::RelocationIndex relocations{source};
+  std::vector<AddressTable::Entry> functions;
+  for (auto &entry : symbols)
+    if (image.IsExecutable(entry.offset)) functions.emplace_back(entry.offset, entry.size, entry.key);
+  AddressTable table{std::move(functions)};
+
+  // pure virtual and imported functions are relocated against their dynamic symbol
+  auto dynstr = source.GetSection(".dynstr");
+  auto dynsym = source.GetSection(".dynsym");
+  if (!dynstr || !dynsym) throw std::runtime_error{"Failed to load .dynsym section"};
+  dynstr->diff = 0;
+  common::MappingView<elf::symbol_data> esyms = std::move(dynsym->data);
+  auto imported = [&](uint32_t index) -> std::optional<std::string> {
+    if (index == 0 || index >= (uint32_t) (esyms.end() - esyms.begin())) return std::nullopt;
+    std::string name = dynstr->GetMapped(esyms[index].st_name);
+    if (name.starts_with("_ZTI") || name.starts_with("_ZTV")) return std::nullopt;
+    return decodeSymbol(name, DecodeMode::Simple);
+  };
+
+  std::vector<DiffImage::Layout> ret;
+  for (auto &entry : symbols) {
+    if (!entry.raw.starts_with("_ZTV") || !entry.size) continue;
+    auto range = image.GetRange(entry.offset);
+    auto words = (uint64_t const *) range.data();
+    auto n     = std::min<size_t>(range.size(), entry.size) / sizeof(uint64_t);
+    DiffImage::Layout layout{entry.key};
+    for (size_t i = 0; i < n; i++) {
+      auto reloc = relocations.Find(entry.offset + i * sizeof(uint64_t));
+      if (reloc && !reloc->target && reloc->symbol) {
+        if (auto name = imported(reloc->symbol)) layout.slots.emplace_back(std::move(*name));
+        continue;
+      }
+      auto value = reloc && reloc->target ? reloc->target : words[i];
+      if (!image.IsExecutable(value)) continue;
+      auto function = table.find(value);
+      layout.slots.emplace_back(function ? function->name : std::format("{:#x}", value));
+    }
+    ret.emplace_back(std::move(layout));
+  }
+  std::sort(ret.begin(), ret.end(), [](auto const &a, auto const &b) { return a.key < b.key; });
+  return ret;
+}
+
+// the vftables found through the rtti, keyed by the decorated class name and the offset of their vfptr
+std::vector<DiffImage::Layout> readPeVtables(
+    std::filesystem::path const &path, std::span<DiffImage::Entry const> symbols) {
+  pe::Image image{path};
+  std::vector<AddressTable::Entry> functions;
+  for (auto &entry : symbols)
+    if (image.IsExecutable((uint32_t) entry.offset)) functions.emplace_back(entry.offset, entry.size, entry.key);
+  AddressTable table{std::move(functions)};
+
+  auto rtti = pe::ScanRtti(image);
+  std::vector<DiffImage::Layout> ret;
+  for (auto &vftable : rtti.vtables) {
+    auto cls = std::lower_bound(
+        rtti.classes.begin(), rtti.classes.end(), vftable.typeDescriptor,
+        [](pe::RttiClass const &c, uint32_t descriptor) { return c.typeDescriptor < descriptor; });
+    if (cls == rtti.classes.end() || cls->typeDescriptor != vftable.typeDescriptor) continue;
+    DiffImage::Layout layout{std::format("{}+{:#x}", cls->name, vftable.offset)};
+    for (auto slot : vftable.slots) {
+      auto function = table.find(slot);
+      layout.slots.emplace_back(function ? function->name : std::format("{:#x}", slot));
+    }
+    ret.emplace_back(std::move(layout));
+  }
+  std::sort(ret.begin(), ret.end(), [](auto const &a, auto const &b) { return a.key < b.key; });
+  return ret;
+}
+
+DiffImage loadDiffImage(std::filesystem::path const &path) {
+  std::ifstream ifs{path, std::ios::binary};
+  if (!ifs) throw std::runtime_error{"Failed to open file"};
+  auto type = detectFileType(ifs);
+  ifs.close();
+  common::ISymbolDumper *dumper;
+  switch (type) {
+  case FileType::PdbFile: dumper = &pdb::GetDumper(); break;
+  case FileType::ElfFile: dumper = &elf::GetDumper(); break;
+  case FileType::PeFile: dumper = &pe::GetDumper(); break;
+  default: throw std::runtime_error{"Unknown source file, expect a pdb, a pe or an elf."};
+  }
+  auto source = dumper->Open(path);
+  auto it     = source->GetIterator();
+  if (!it) throw std::runtime_error{"No symbol in source file."};
+
+  DiffImage ret;
+  do {
+    auto sym = it->Get();
+    if (sym.Offset) ret.symbols.push_back({{}, std::move(sym.Name), sym.Offset, sym.Size});
+  } while (it->Next());
+
+  // demangling dominates, every worker decodes its own slice
+  ParallelFor(ret.symbols.size(), [&](unsigned, size_t first, size_t last) {
+    for (auto i = first; i < last; i++) ret.symbols[i].key = decodeSymbol(ret.symbols[i].raw, DecodeMode::Simple);
+  });
+  std::sort(ret.symbols.begin(), ret.symbols.end(), [](DiffImage::Entry const &a, DiffImage::Entry const &b) {
+    return std::tie(a.key, a.raw, a.offset) < std::tie(b.key, b.raw, b.offset);
+  });
+  if (type == FileType::ElfFile)
+    ret.vtables = readElfVtables(*(elf::IElfDumpSource *) source.get(), ret.symbols);
+  else if (type == FileType::PeFile)
+    ret.vtables = readPeVtables(path, ret.symbols);
+  else // the slots of the vftables are only in the image
+    std::cerr << "warning: a pdb has no vtable contents, pass the pe to compare the vtables of " << path << "."
+              << std::endl;
+  std::cerr << "loaded " << ret.symbols.size() << " symbols and " << ret.vtables.size() << " vtables from " << path
+            << "." << std::endl;
+  return ret;
+}
+
+// merge-joins both sorted lists by key, runs of equal keys are paired in order
+template <typename T, typename Removed, typename Added, typename Matched>
+void mergeJoin(std::span<T const> a, std::span<T const> b, Removed &&removed, Added &&added, Matched &&matched) {
+  size_t i = 0, j = 0;
+  while (i < a.size() || j < b.size()) {
+    if (j == b.size() || (i < a.size() && a[i].key < b[j].key))
+      removed(a[i++]);
+    else if (i == a.size() || b[j].key < a[i].key)
+      added(b[j++]);
+    else
+      matched(a[i++], b[j++]);
+  }
+}
+
+// prints `- key` for removed symbols, `+ key` for added ones, `> key old -> new` for moved or resized ones
+// and the slots of changed vtable layouts
+void diffBinaries(std::filesystem::path const &oldPath, std::filesystem::path const &newPath) {
+  auto before = loadDiffImage(oldPath);
+  auto after  = loadDiffImage(newPath);
+
+  std::ios::sync_with_stdio(false);
+  std::string out;
+  size_t removed = 0, added = 0, moved = 0, reordered = 0, changed = 0;
+  auto flush = [&] {
+    if (out.size() < (1 << 16)) return;
+    std::cout << out;
+    out.clear();
+  };
+  mergeJoin<DiffImage::Entry>(
+      before.symbols, after.symbols,
+      [&](DiffImage::Entry const &entry) {
+        std::format_to(std::back_inserter(out), "- {} {:#x}\n", entry.key, entry.offset);
+        removed++;
+        flush();
+      },
+      [&](DiffImage::Entry const &entry) {
+        std::format_to(std::back_inserter(out), "+ {} {:#x}\n", entry.key, entry.offset);
+        added++;
+        flush();
+      },
+      [&](DiffImage::Entry const &a, DiffImage::Entry const &b) {
+        if (a.offset == b.offset && a.size == b.size) return;
+        std::format_to(
+            std::back_inserter(out), "> {} {:#x}+{:#x} -> {:#x}+{:#x}\n", a.key, a.offset, a.size, b.offset, b.size);
+        moved++;
+        flush();
+      });
+  mergeJoin<DiffImage::Layout>(
+      before.vtables, after.vtables, [](auto const &) {}, [](auto const &) {},
+      [&](DiffImage::Layout const &a, DiffImage::Layout const &b) {
+        if (a.slots == b.slots) return;
+        auto permuted = std::is_permutation(a.slots.begin(), a.slots.end(), b.slots.begin(), b.slots.end());
+        std::format_to(std::back_inserter(out), "* {} {}\n", a.key, permuted ? "reordered" : "changed");
+        (permuted ? reordered : changed)++;
+        for (size_t i = 0; i < std::max(a.slots.size(), b.slots.size()); i++) {
+          auto x = i < a.slots.size() ? std::string_view{a.slots[i]} : "<none>";
+          auto y = i < b.slots.size() ? std::string_view{b.slots[i]} : "<none>";
+          if (x != y) std::format_to(std::back_inserter(out), "  [{}] {} -> {}\n", i, x, y);
+        }
+        flush();
+      });
+  std::cout << out;
+  std::cout.flush();
+  std::cerr << removed << " removed, " << added << " added, " << moved << " moved, " << reordered
+            << " vtables reordered, " << changed << " vtables changed." << std::endl;
+}
+
+void serve(std::filesystem::path const &path, std::filesystem::path const &source) {
+  WSADATA wsa;
+  if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) throw std::runtime_error{"Failed to initialize winsock"};
+  SymbolServer server{source};
+
+  sockaddr_un addr{.sun_family = AF_UNIX};
+  auto name = path.u8string();
+  if (name.size() >= sizeof addr.sun_path) throw std::runtime_error{"Socket path too long"};
+  memcpy(addr.sun_path, name.c_str(), name.size());
+  DeleteFileW(path.c_str());
+
+  auto listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener == INVALID_SOCKET) throw std::runtime_error{"Failed to create socket"};
+  if (bind(listener, (sockaddr *) &addr, sizeof addr) == SOCKET_ERROR || listen(listener, SOMAXCONN) == SOCKET_ERROR) {
+    closesocket(listener);
+    throw std::runtime_error{"Failed to listen on " + path.string()};
+  }
+  std::cerr << "listening on " << path << "..." << std::endl;
+
+  // ctrl+c and closing the console stop the server the same way the shutdown request does
+  static SymbolServer *running;
+  running          = &server;
+  auto interrupted = [](DWORD) -> BOOL {
+    running->stop();
+    return TRUE;
+  };
+  SetConsoleCtrlHandler(interrupted, TRUE);
+  server.run(listener);
+  SetConsoleCtrlHandler(interrupted, FALSE);
+  DeleteFileW(path.c_str());
+  WSACleanup();
 }
 
 void GetElfSections(std::filesystem::path const &elf) {
@@ -628,12 +1686,34 @@ int wmain(int argc, wchar_t *argv[]) {
         do_DecodeSymbol(argv[2], DecodeMode::Simple);
       } else if (_wcsicmp(argv[1], L"decode-original") == 0) {
         do_DecodeSymbol(argv[2], DecodeMode::Original);
+      } else if (_wcsicmp(argv[1], L"symbolize-frames") == 0) {
+        symbolizeFrames(argv[2], std::cin);
+      } else
+        return unknownCommand(argv[1]);
+      break;
+    case 4:
+      if (_wcsicmp(argv[1], L"symbolize") == 0) {
+        symbolize(argv[2], argv[3]);
+      } else if (_wcsicmp(argv[1], L"symbolize-frames") == 0) {
+        symbolizeFrames(argv[2], std::filesystem::path{argv[3]});
+      } else if (_wcsicmp(argv[1], L"serve") == 0) {
+        serve(argv[2], argv[3]);
+      } else if (_wcsicmp(argv[1], L"diff") == 0) {
+        diffBinaries(argv[2], argv[3]);
       } else
         return unknownCommand(argv[1]);
       break;
     case 5:
       if (_wcsicmp(argv[1], L"build-database") == 0) {
         buildDatabase(argv[2], argv[3], argv[4]);
+      } else if (_wcsicmp(argv[1], L"merge-database") == 0) {
+        mergeDatabase(argv[2], argv[3], argv[4]);
+      } else
+        return unknownCommand(argv[1]);
+      break;
+    case 6:
+      if (_wcsicmp(argv[1], L"build-database") == 0) {
+        buildDatabase(argv[2], argv[3], argv[4], argv[5]);
       } else
         return unknownCommand(argv[1]);
       break;
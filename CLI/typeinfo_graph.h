@@ -0,0 +1,115 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <optional>
+#include <set>
+#include <span>
+#include <utility>
+#include <vector>
+
+// Class hierarchy read from the itanium type_info objects, stored as parallel arrays.
+// Nodes are sorted by the offset of their type_info, the base edges of node i are
+// bases[first[i], first[i + 1]) with the matching __offset_flags in offsetFlags.
+// Nothing refers back to the builder once Finish() returned, so the graph can be shared by readers.
+class TypeInfoGraph {
+public:
+  enum Kind : uint8_t {
+    NoInherit,
+    SingleInherit,
+    VirtualMultiInherit,
+  };
+
+  struct Ancestor {
+    uint64_t key;
+    int depth;
+    std::optional<int64_t> offset; // unknown once a virtual base is crossed
+  };
+
+  // the first definition of a key wins, bases of single inheritance carry no offset flags
+  void Add(uint64_t key, Kind kind, uint32_t flag, std::span<uint64_t const> base, std::span<int64_t const> offset) {
+    keys.push_back(key);
+    kinds.push_back(kind);
+    flags.push_back(flag);
+    bases.insert(bases.end(), base.begin(), base.end());
+    offsetFlags.insert(offsetFlags.end(), offset.begin(), offset.end());
+    offsetFlags.resize(bases.size());
+    first.push_back((uint32_t) bases.size());
+  }
+
+  // sorts the nodes and drops duplicates, call once after the last Add
+  void Finish() {
+    std::vector<uint32_t> order(keys.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+    order.erase(
+        std::unique(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keys[a] == keys[b]; }),
+        order.end());
+
+    // first currently holds the end of every node in insertion order
+    TypeInfoGraph sorted;
+    sorted.keys.reserve(order.size());
+    sorted.kinds.reserve(order.size());
+    sorted.flags.reserve(order.size());
+    sorted.first.reserve(order.size() + 1);
+    sorted.first.push_back(0);
+    for (auto i : order) {
+      auto begin = i == 0 ? 0 : first[i - 1], end = first[i];
+      sorted.keys.push_back(keys[i]);
+      sorted.kinds.push_back(kinds[i]);
+      sorted.flags.push_back(flags[i]);
+      sorted.bases.insert(sorted.bases.end(), bases.begin() + begin, bases.begin() + end);
+      sorted.offsetFlags.insert(sorted.offsetFlags.end(), offsetFlags.begin() + begin, offsetFlags.begin() + end);
+      sorted.first.push_back((uint32_t) sorted.bases.size());
+    }
+    *this = std::move(sorted);
+  }
+
+  uint32_t size() const { return (uint32_t) keys.size(); }
+
+  std::optional<uint32_t> Find(uint64_t key) const {
+    auto it = std::lower_bound(keys.begin(), keys.end(), key);
+    if (it == keys.end() || *it != key) return std::nullopt;
+    return (uint32_t) (it - keys.begin());
+  }
+
+  uint64_t KeyOf(uint32_t i) const { return keys[i]; }
+  Kind KindOf(uint32_t i) const { return kinds[i]; }
+  uint32_t FlagsOf(uint32_t i) const { return flags[i]; }
+  std::span<uint64_t const> BasesOf(uint32_t i) const { return {bases.data() + first[i], bases.data() + first[i + 1]}; }
+  std::span<int64_t const> OffsetFlagsOf(uint32_t i) const {
+    return {offsetFlags.data() + first[i], offsetFlags.data() + first[i + 1]};
+  }
+
+  // every ancestor of node i including itself, one entry per distinct offset with the shortest depth.
+  // Only reads the graph, so it can run for several nodes at once.
+  std::vector<Ancestor> AncestorsOf(uint32_t i, int maxDepth = 64) const {
+    std::set<std::pair<uint64_t, std::optional<int64_t>>> seen{{keys[i], 0}};
+    std::vector<Ancestor> ret{{keys[i], 0, 0}};
+    // breadth first, so the first time a pair is reached is the shortest path to it
+    for (size_t head = 0; head < ret.size(); head++) {
+      auto current = ret[head];
+      if (current.depth >= maxDepth) continue; // malformed cycles
+      auto node = Find(current.key);
+      if (!node) continue;
+      auto base = BasesOf(*node);
+      auto offset = OffsetFlagsOf(*node);
+      for (size_t j = 0; j < base.size(); j++) {
+        // __virtual_mask, the offset of a virtual base is only known through the vtable
+        std::optional<int64_t> cumulative;
+        if (!(offset[j] & 1) && current.offset) cumulative = *current.offset + (offset[j] >> 8);
+        if (seen.emplace(base[j], cumulative).second) ret.push_back({base[j], current.depth + 1, cumulative});
+      }
+    }
+    return ret;
+  }
+
+private:
+  std::vector<uint64_t> keys;       // sorted type_info offsets
+  std::vector<Kind> kinds;          // per node
+  std::vector<uint32_t> flags;      // __flags of __vmi_class_type_info, per node
+  std::vector<uint32_t> first;      // size() + 1 edge starts
+  std::vector<uint64_t> bases;      // base type_info offset per edge
+  std::vector<int64_t> offsetFlags; // __offset_flags per edge
+};
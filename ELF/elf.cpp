@@ -1,8 +1,11 @@
 #include "include/elf.h"
 
+#include <algorithm>
 #include <cassert>
 #include <fstream>
 #include <memory>
+#include <thread>
+#include <TaskPool.h>
 #include <Windows.h>
 #include <handleapi.h>
 #include <windowscommon.h>
@@ -13,7 +16,9 @@ struct SymbolIterator : public ISymbolIterator {
   MappingView<symbol_data> syms;
   MappingView<char> strtab;
   symbol_data *it{};
-  virtual Symbol Get() override { return Symbol{.Name = &strtab[it->st_name], .Offset = it->st_value}; }
+  virtual Symbol Get() override {
+    return Symbol{.Name = &strtab[it->st_name], .Offset = it->st_value, .Size = it->st_size};
+  }
   virtual bool Next() override { return ++it < syms.end(); }
 };
 
@@ -64,6 +69,22 @@ struct DumpSource : public IElfDumpSource {
     return ret;
   }
 
+  virtual AddressSpace GetAddressSpace() override {
+    std::vector<AddressSpace::Segment> segments;
+    if (header->e_phnum) {
+      MappingView<program_header> programs{map, (DWORD) header->e_phoff, (DWORD) header->e_phnum};
+      for (auto &program : programs)
+        if (program.p_type == PT_LOAD && program.p_filesz)
+          segments.push_back({program.p_vaddr, program.p_offset, program.p_filesz, program.p_flags});
+    } else {
+      for (auto &section : sections)
+        if ((section.sh_flags & SHF_ALLOC) && section.sh_type != SHT_NOBITS && section.sh_size)
+          segments.push_back({section.sh_addr, section.sh_offset, section.sh_size,
+                              (uint32_t) PF_R | ((section.sh_flags & SHF_EXECINSTR) ? PF_X : 0)});
+    }
+    return AddressSpace{MappingView<char>{map}, std::move(segments)};
+  }
+
   virtual std::optional<SectionData> GetSection(std::string const &name) override {
     for (auto &section : sections) {
       if (name == &shstrtab[section.sh_name]) {
@@ -81,6 +102,130 @@ public:
   }
 };
 
+AddressSpace::AddressSpace(MappingView<char> &&image, std::vector<Segment> list)
+    : image(std::move(image)), segments(std::move(list)) {
+  base = this->image.begin();
+  std::sort(segments.begin(), segments.end(), [](Segment const &a, Segment const &b) { return a.address < b.address; });
+  byOffset.resize(segments.size());
+  for (uint32_t i = 0; i < byOffset.size(); i++) byOffset[i] = i;
+  std::sort(byOffset.begin(), byOffset.end(), [&](uint32_t a, uint32_t b) {
+    return segments[a].offset < segments[b].offset;
+  });
+}
+
+AddressSpace::Segment const *AddressSpace::SegmentOf(uint64_t va) const {
+  auto it = std::upper_bound(
+      segments.begin(), segments.end(), va, [](uint64_t va, Segment const &segment) { return va < segment.address; });
+  if (it == segments.begin()) return nullptr;
+  --it;
+  return va - it->address < it->size ? &*it : nullptr;
+}
+
+bool AddressSpace::IsExecutable(uint64_t va) const {
+  auto segment = SegmentOf(va);
+  return segment && (segment->flags & PF_X);
+}
+
+std::optional<uint64_t> AddressSpace::ToFile(uint64_t va) const {
+  if (auto segment = SegmentOf(va)) return segment->offset + (va - segment->address);
+  return std::nullopt;
+}
+
+std::optional<uint64_t> AddressSpace::ToAddress(uint64_t offset) const {
+  auto it = std::upper_bound(byOffset.begin(), byOffset.end(), offset, [&](uint64_t offset, uint32_t idx) {
+    return offset < segments[idx].offset;
+  });
+  if (it == byOffset.begin()) return std::nullopt;
+  auto &segment = segments[*--it];
+  if (offset - segment.offset >= segment.size) return std::nullopt;
+  return segment.address + (offset - segment.offset);
+}
+
+char *AddressSpace::GetMapped(uint64_t va, size_t size) {
+  auto segment = SegmentOf(va);
+  if (!segment || size > segment->size - (va - segment->address)) return nullptr;
+  return base + segment->offset + (va - segment->address);
+}
+
+std::span<char> AddressSpace::GetRange(uint64_t va) {
+  auto segment = SegmentOf(va);
+  if (!segment) return {};
+  auto start = base + segment->offset + (va - segment->address);
+  return {start, (size_t) (segment->size - (va - segment->address))};
+}
+
+std::optional<uint64_t> AddressSpace::GetAddress(char const *ptr) const {
+  if (ptr < base) return std::nullopt;
+  return ToAddress((uint64_t) (ptr - base));
+}
+
+RelocationIndex::RelocationIndex(IElfDumpSource &source, unsigned threads) {
+  auto less = [](Relocation const &a, Relocation const &b) { return a.offset < b.offset; };
+  std::vector<Relocation> all;
+
+  if (auto rela = source.GetSection(".rela.dyn")) {
+    MappingView<elf_rela> entries = std::move(rela->data);
+    MappingView<symbol_data> syms;
+    if (auto dynsym = source.GetSection(".dynsym")) syms = std::move(dynsym->data);
+
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    auto count    = (size_t) (entries.end() - entries.begin());
+    auto symCount = (size_t) (syms.end() - syms.begin());
+    std::vector<std::vector<Relocation>> parts(threads);
+    ParallelFor(
+        count,
+        [&](unsigned slice, size_t first, size_t last) {
+          auto &part = parts[slice];
+          for (auto it = entries.begin() + first, end = entries.begin() + last; it != end; it++) {
+            if (it->r_type == R_X86_64_RELATIVE) {
+              part.push_back({it->offset, (uint64_t) it->r_addend, 0, R_X86_64_RELATIVE});
+            } else if (it->r_type == R_X86_64_64) {
+              // a symbol index past .dynsym leaves the target unresolved, like an undefined symbol
+              auto value = it->r_sym < symCount ? syms[it->r_sym].st_value : 0;
+              part.push_back({it->offset, value ? value + it->r_addend : 0, it->r_sym, R_X86_64_64});
+            }
+          }
+          // linkers mostly emit them in order already
+          if (!std::is_sorted(part.begin(), part.end(), less)) std::sort(part.begin(), part.end(), less);
+        },
+        threads);
+    for (auto &part : parts) {
+      auto middle = all.size();
+      all.insert(all.end(), part.begin(), part.end());
+      std::inplace_merge(all.begin(), all.begin() + middle, all.end(), less);
+    }
+  }
+
+  // relative relocations packed as address and bitmap words, the addend stays in place
+  if (auto relr = source.GetSection(".relr.dyn")) {
+    MappingView<uint64_t> entries = std::move(relr->data);
+    auto middle                   = all.size();
+    uint64_t where                = 0;
+    for (auto entry : entries) {
+      if ((entry & 1) == 0) {
+        all.push_back({entry, 0, 0, R_X86_64_RELATIVE});
+        where = entry + 8;
+      } else {
+        for (int bit = 1; bit < 64; bit++)
+          if (entry >> bit & 1) all.push_back({where + (bit - 1) * 8, 0, 0, R_X86_64_RELATIVE});
+        where += 63 * 8;
+      }
+    }
+    std::inplace_merge(all.begin(), all.begin() + middle, all.end(), less);
+  }
+
+  offsets.reserve(all.size());
+  targets.reserve(all.size());
+  symbols.reserve(all.size());
+  types.reserve(all.size());
+  for (auto &relocation : all) {
+    offsets.push_back(relocation.offset);
+    targets.push_back(relocation.target);
+    symbols.push_back(relocation.symbol);
+    types.push_back((uint8_t) relocation.type);
+  }
+}
+
 ISymbolDumper &elf::GetDumper() {
   static SymbolDumper ret;
   return ret;
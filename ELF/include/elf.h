@@ -3,6 +3,8 @@
 #include <memory>
 #include <filesystem>
 #include <optional>
+#include <span>
+#include <vector>
 
 #include <dumpcommon.h>
 #include <windowscommon.h>
@@ -41,9 +43,39 @@ struct SectionHeader {
       : name(std::move(name)), address(address), offset(offset), size(size) {}
 };
 
+// The whole image as loaded, translates between virtual addresses and the file through the PT_LOAD segments
+// (or the allocated sections when there are no program headers).
+class AddressSpace {
+public:
+  struct Segment {
+    uint64_t address, offset, size; // file backed part only
+    uint32_t flags;                 // PF
+  };
+
+  AddressSpace(MappingView<char> &&image, std::vector<Segment> segments);
+
+  // nullptr unless [va, va + size) is file backed inside one segment
+  char *GetMapped(uint64_t va, size_t size = 1);
+  // bytes from va up to the end of its segment
+  std::span<char> GetRange(uint64_t va);
+  // virtual address of a pointer returned by GetMapped
+  std::optional<uint64_t> GetAddress(char const *ptr) const;
+  std::optional<uint64_t> ToFile(uint64_t va) const;
+  std::optional<uint64_t> ToAddress(uint64_t offset) const;
+  Segment const *SegmentOf(uint64_t va) const;
+  bool IsExecutable(uint64_t va) const;
+
+private:
+  MappingView<char> image;
+  char *base{};
+  std::vector<Segment> segments;   // sorted by address
+  std::vector<uint32_t> byOffset; // segments sorted by file offset
+};
+
 struct IElfDumpSource : IDumpSource {
   virtual std::vector<SectionHeader> GetSectionHeaders()                 = 0;
   virtual std::optional<SectionData> GetSection(std::string const &name) = 0;
+  virtual AddressSpace GetAddressSpace()                                 = 0;
 };
 
 ISymbolDumper &GetDumper();
@@ -137,6 +169,32 @@ struct section_header {
   elf_qword_t sh_entsize;
 };
 
+struct program_header {
+  // Kind of segment, PT_LOAD for the ones mapped in memory
+  elf_word_t p_type;
+
+  // Access rights, PF_X, PF_W and PF_R
+  elf_word_t p_flags;
+
+  // Offset of the segment in the file image
+  elf_qword_t p_offset;
+
+  // Virtual address of the segment in memory
+  elf_qword_t p_vaddr;
+
+  // Physical address, unused
+  elf_qword_t p_paddr;
+
+  // Size in bytes of the segment in the file image, the rest of p_memsz is zero filled
+  elf_qword_t p_filesz;
+
+  // Size in bytes of the segment in memory
+  elf_qword_t p_memsz;
+
+  // Required alignment
+  elf_qword_t p_align;
+};
+
 struct symbol_data {
   // Index into the string table of the name of the symbol, or 0 for scratch
   // register
@@ -162,7 +220,54 @@ struct elf_rela {
   elf_long_t r_addend;
 };
 
-enum SHT { SHT_DYNSYM = 11 };
+enum SHT { SHT_NOBITS = 8, SHT_DYNSYM = 11 };
+
+enum SHF { SHF_ALLOC = 2, SHF_EXECINSTR = 4 };
+
+enum PT { PT_LOAD = 1 };
+
+enum PF { PF_X = 1, PF_W = 2, PF_R = 4 };
+
+enum RelocationType { R_X86_64_64 = 1, R_X86_64_RELATIVE = 8 };
+
+struct Relocation {
+  uint64_t offset;
+  // S + A, or A for relative relocations, 0 when the slot keeps its own content (relr, undefined symbols)
+  uint64_t target;
+  uint32_t symbol; // index into .dynsym, 0 for relative relocations
+  uint32_t type;   // RelocationType
+};
+
+// Dynamic relocations of data slots (R_X86_64_64 and R_X86_64_RELATIVE from .rela.dyn, plus .relr.dyn),
+// kept as flat arrays sorted by the patched offset. The offsets are searched on their own, so a lookup only
+// touches one array.
+class RelocationIndex {
+  std::vector<uint64_t> offsets;
+  std::vector<uint64_t> targets;
+  std::vector<uint32_t> symbols;
+  std::vector<uint8_t> types;
+
+public:
+  RelocationIndex() = default;
+  // scans .rela.dyn on threads workers, 0 for one per core
+  explicit RelocationIndex(IElfDumpSource &source, unsigned threads = 0);
+
+  size_t size() const { return offsets.size(); }
+  Relocation operator[](size_t idx) const { return {offsets[idx], targets[idx], symbols[idx], types[idx]}; }
+  // relocation patching exactly offset
+  std::optional<Relocation> Find(uint64_t offset) const {
+    if (offsets.empty()) return std::nullopt;
+    auto base = offsets.data();
+    auto len  = offsets.size();
+    while (len > 1) {
+      auto half = len / 2;
+      base      = base[half - 1] < offset ? base + half : base;
+      len -= half;
+    }
+    if (*base != offset) return std::nullopt;
+    return (*this)[base - offsets.data()];
+  }
+};
 
 static constexpr int elf_header_size     = sizeof(elf_header);
 static constexpr int section_header_size = sizeof(section_header);
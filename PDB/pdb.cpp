@@ -42,9 +42,12 @@ public:
   virtual Symbol Get() override {
     BStrHelper cache;
     DWORD offset;
+    ULONGLONG length = 0;
     psym->get_name(&cache);
-    psym->get_addressOffset(&offset);
-    return Symbol{.Name = cache, .Offset = offset};
+    // rva, so windows offsets match module+offset frames and the pe image
+    psym->get_relativeVirtualAddress(&offset);
+    psym->get_length(&length);
+    return Symbol{.Name = cache, .Offset = offset, .Size = length};
   }
 
   virtual bool Next() override {
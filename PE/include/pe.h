@@ -0,0 +1,268 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <dumpcommon.h>
+#include <windowscommon.h>
+
+namespace pe {
+
+using namespace common;
+
+struct dos_header {
+  // "MZ"
+  uint16_t e_magic;
+  uint16_t e_unused[29];
+  // Offset of the nt headers
+  int32_t e_lfanew;
+};
+
+struct file_header {
+  // 0x8664 for x86-64
+  uint16_t Machine;
+  uint16_t NumberOfSections;
+  uint32_t TimeDateStamp;
+  // File offset of the COFF symbol table, 0 when stripped
+  uint32_t PointerToSymbolTable;
+  uint32_t NumberOfSymbols;
+  uint16_t SizeOfOptionalHeader;
+  uint16_t Characteristics;
+};
+
+struct data_directory {
+  uint32_t VirtualAddress;
+  uint32_t Size;
+};
+
+enum DirectoryEntry { DIRECTORY_EXPORT = 0, DIRECTORY_IMPORT = 1 };
+
+struct optional_header64 {
+  // 0x20b for PE32+
+  uint16_t Magic;
+  uint8_t MajorLinkerVersion;
+  uint8_t MinorLinkerVersion;
+  uint32_t SizeOfCode;
+  uint32_t SizeOfInitializedData;
+  uint32_t SizeOfUninitializedData;
+  uint32_t AddressOfEntryPoint;
+  uint32_t BaseOfCode;
+  // Preferred load address, every absolute pointer in the image assumes it
+  uint64_t ImageBase;
+  uint32_t SectionAlignment;
+  uint32_t FileAlignment;
+  uint16_t MajorOperatingSystemVersion;
+  uint16_t MinorOperatingSystemVersion;
+  uint16_t MajorImageVersion;
+  uint16_t MinorImageVersion;
+  uint16_t MajorSubsystemVersion;
+  uint16_t MinorSubsystemVersion;
+  uint32_t Win32VersionValue;
+  uint32_t SizeOfImage;
+  uint32_t SizeOfHeaders;
+  uint32_t CheckSum;
+  uint16_t Subsystem;
+  uint16_t DllCharacteristics;
+  uint64_t SizeOfStackReserve;
+  uint64_t SizeOfStackCommit;
+  uint64_t SizeOfHeapReserve;
+  uint64_t SizeOfHeapCommit;
+  uint32_t LoaderFlags;
+  uint32_t NumberOfRvaAndSizes;
+  data_directory DataDirectory[16];
+};
+
+struct section_header {
+  char Name[8];
+  // Size of the section in memory
+  uint32_t VirtualSize;
+  uint32_t VirtualAddress;
+  // Size of the section in the file, rounded to the file alignment
+  uint32_t SizeOfRawData;
+  uint32_t PointerToRawData;
+  uint32_t PointerToRelocations;
+  uint32_t PointerToLinenumbers;
+  uint16_t NumberOfRelocations;
+  uint16_t NumberOfLinenumbers;
+  uint32_t Characteristics;
+};
+
+struct export_directory {
+  uint32_t Characteristics;
+  uint32_t TimeDateStamp;
+  uint16_t MajorVersion;
+  uint16_t MinorVersion;
+  // Name of the dll
+  uint32_t Name;
+  // Ordinal of the first function
+  uint32_t Base;
+  uint32_t NumberOfFunctions;
+  uint32_t NumberOfNames;
+  // Function rvas, indexed by ordinal - Base
+  uint32_t AddressOfFunctions;
+  // Name rvas, sorted
+  uint32_t AddressOfNames;
+  // uint16_t index into AddressOfFunctions for every name
+  uint32_t AddressOfNameOrdinals;
+};
+
+struct import_descriptor {
+  // Import lookup table, the untouched copy of FirstThunk
+  uint32_t OriginalFirstThunk;
+  uint32_t TimeDateStamp;
+  uint32_t ForwarderChain;
+  // Name of the dll
+  uint32_t Name;
+  // Import address table, patched by the loader
+  uint32_t FirstThunk;
+};
+
+#pragma pack(push, 2)
+struct coff_symbol {
+  // Inline name when it fits, otherwise zeroes followed by an offset into the string table
+  union {
+    char ShortName[8];
+    struct {
+      uint32_t Zeroes;
+      uint32_t Offset;
+    } LongName;
+  };
+  // Offset inside the section for definitions
+  uint32_t Value;
+  // 1-based section index, 0 undefined, negative for absolute and debug symbols
+  int16_t SectionNumber;
+  uint16_t Type;
+  uint8_t StorageClass;
+  uint8_t NumberOfAuxSymbols;
+};
+#pragma pack(pop)
+
+enum SYM_CLASS : uint8_t { SYM_CLASS_EXTERNAL = 2, SYM_CLASS_STATIC = 3 };
+
+enum SCN : uint32_t { SCN_MEM_EXECUTE = 0x20000000, SCN_MEM_READ = 0x40000000, SCN_MEM_WRITE = 0x80000000 };
+
+// msvc rtti on x64, every pointer is an rva
+struct rtti_complete_object_locator {
+  // 1 on x64
+  uint32_t signature;
+  // Offset of the vfptr in the complete object
+  uint32_t offset;
+  // Offset of the constructor displacement
+  uint32_t cdOffset;
+  int32_t pTypeDescriptor;
+  int32_t pClassDescriptor;
+  // The locator itself
+  int32_t pSelf;
+};
+
+struct rtti_class_hierarchy_descriptor {
+  uint32_t signature;
+  // 1 multiple inheritance, 2 virtual inheritance
+  uint32_t attributes;
+  uint32_t numBaseClasses;
+  // numBaseClasses rtti_base_class_descriptor rvas, the class itself first, then its bases in depth first order
+  int32_t pBaseClassArray;
+};
+
+struct rtti_base_class_descriptor {
+  int32_t pTypeDescriptor;
+  // Bases of this one following it in the array
+  uint32_t numContainedBases;
+  // Member displacement
+  int32_t mdisp;
+  // Vbtable displacement, -1 for non virtual bases
+  int32_t pdisp;
+  // Displacement inside the vbtable
+  int32_t vdisp;
+  uint32_t attributes;
+  int32_t pClassDescriptor;
+};
+
+// type_info object, followed by the decorated name (".?AVFoo@@")
+struct rtti_type_descriptor {
+  uint64_t pVFTable;
+  uint64_t spare;
+};
+
+// A mapped PE32+ image, addressed by rva.
+class Image {
+public:
+  struct Section {
+    std::string name;
+    uint32_t address, size; // in memory
+    uint32_t offset, rawSize; // in the file
+    uint32_t characteristics;
+  };
+
+  // throws std::runtime_error when the file is not a PE32+ image
+  explicit Image(std::filesystem::path const &path);
+
+  uint64_t ImageBase() const { return imageBase; }
+  file_header const &FileHeader() const { return *fileHeader; }
+  data_directory Directory(int entry) const;
+  std::span<Section const> Sections() const { return sections; }
+  Section const *SectionOf(uint32_t rva) const;
+  // section by its 1-based position in the section table, as numbered by coff symbols
+  Section const *SectionByNumber(int32_t number) const;
+  bool IsExecutable(uint32_t rva) const;
+  // rva of an absolute address, when it lands inside the image
+  std::optional<uint32_t> ToRva(uint64_t va) const;
+  uint32_t EntryPoint() const { return optionalHeader->AddressOfEntryPoint; }
+
+  // nullptr unless [rva, rva + size) is backed by the file inside one section
+  char *GetMapped(uint32_t rva, size_t size = 1);
+  // nullptr unless [offset, offset + size) is inside the file
+  char *GetFileMapped(uint64_t offset, size_t size = 1);
+  // nul terminated string at rva, empty when out of the image
+  std::string_view GetString(uint32_t rva);
+
+private:
+  WindowsFileMapping map;
+  MappingView<char> view;
+  char *base;
+  uint64_t fileSize;
+  file_header const *fileHeader;
+  optional_header64 const *optionalHeader;
+  uint64_t imageBase;
+  std::vector<Section> sections; // sorted by address
+  std::vector<uint32_t> ordinals; // index into sections of every header, in table order
+};
+
+struct RttiVtable {
+  uint32_t address;        // rva of the first slot
+  uint32_t locator;        // rva of the complete object locator before it
+  uint32_t offset;         // of the vfptr in the complete object
+  uint32_t typeDescriptor; // rva
+  std::vector<uint32_t> slots;
+};
+
+struct RttiBase {
+  uint32_t typeDescriptor;
+  int32_t mdisp, pdisp, vdisp;
+  uint32_t attributes;
+};
+
+struct RttiClass {
+  uint32_t typeDescriptor;
+  uint32_t attributes; // of the class hierarchy descriptor
+  std::string name;    // decorated, .?AVFoo@@
+  std::vector<RttiBase> bases; // direct ones only
+};
+
+struct Rtti {
+  std::vector<RttiVtable> vtables; // sorted by address
+  std::vector<RttiClass> classes;  // sorted by type descriptor
+};
+
+// Exports, imports (as __imp_<name> at their import address table slot) and COFF symbols of an image.
+// Offsets are rvas, like the ones of the pdb.
+ISymbolDumper &GetDumper();
+
+// Finds every vftable through the complete object locator stored in front of it, in one scan of the
+// readonly data split across threads workers (0 for one per core).
+Rtti ScanRtti(Image &image, unsigned threads = 0);
+
+} // namespace pe
@@ -0,0 +1,315 @@
+#include "include/pe.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <TaskPool.h>
+
+namespace pe {
+
+Image::Image(std::filesystem::path const &path) : map(path), view(map) {
+  base     = view.begin();
+  fileSize = std::filesystem::file_size(path);
+
+  auto dos = (dos_header const *) GetFileMapped(0, sizeof(dos_header));
+  if (!dos || dos->e_magic != 0x5A4D || dos->e_lfanew < 0) throw std::runtime_error{"Not a pe image"};
+  uint64_t nt    = (uint64_t) dos->e_lfanew;
+  auto signature = GetFileMapped(nt, 4);
+  fileHeader     = (file_header const *) GetFileMapped(nt + 4, sizeof(file_header));
+  if (!signature || memcmp(signature, "PE\0\0", 4) != 0 || !fileHeader) throw std::runtime_error{"Not a pe image"};
+  optionalHeader = (optional_header64 const *) GetFileMapped(nt + 4 + sizeof(file_header), sizeof(optional_header64));
+  if (!optionalHeader || fileHeader->SizeOfOptionalHeader < sizeof(optional_header64) || optionalHeader->Magic != 0x20b)
+    throw std::runtime_error{"Not a PE32+ image"};
+  imageBase = optionalHeader->ImageBase;
+
+  auto table = (section_header const *) GetFileMapped(
+      nt + 4 + sizeof(file_header) + fileHeader->SizeOfOptionalHeader,
+      sizeof(section_header) * fileHeader->NumberOfSections);
+  if (!table) throw std::runtime_error{"Truncated pe image"};
+  for (auto it = table, end = table + fileHeader->NumberOfSections; it != end; it++)
+    sections.push_back(
+        {std::string{it->Name, strnlen(it->Name, sizeof it->Name)}, it->VirtualAddress,
+         it->VirtualSize ? it->VirtualSize : it->SizeOfRawData, it->PointerToRawData, it->SizeOfRawData,
+         it->Characteristics});
+  // the table is usually but not necessarily in address order, coff symbols still refer to it by position
+  std::vector<uint32_t> order(sections.size());
+  for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return sections[a].address < sections[b].address;
+  });
+  std::vector<Section> sorted;
+  ordinals.resize(order.size());
+  for (uint32_t i = 0; i < order.size(); i++) {
+    ordinals[order[i]] = i;
+    sorted.push_back(std::move(sections[order[i]]));
+  }
+  sections = std::move(sorted);
+}
+
+data_directory Image::Directory(int entry) const {
+  if ((uint32_t) entry >= optionalHeader->NumberOfRvaAndSizes) return {};
+  return optionalHeader->DataDirectory[entry];
+}
+
+Image::Section const *Image::SectionOf(uint32_t rva) const {
+  auto it = std::upper_bound(sections.begin(), sections.end(), rva, [](uint32_t rva, Section const &section) {
+    return rva < section.address;
+  });
+  if (it == sections.begin()) return nullptr;
+  --it;
+  return rva - it->address < it->size ? &*it : nullptr;
+}
+
+Image::Section const *Image::SectionByNumber(int32_t number) const {
+  if (number <= 0 || (size_t) number > ordinals.size()) return nullptr;
+  return &sections[ordinals[number - 1]];
+}
+
+bool Image::IsExecutable(uint32_t rva) const {
+  auto section = SectionOf(rva);
+  return section && (section->characteristics & SCN_MEM_EXECUTE);
+}
+
+std::optional<uint32_t> Image::ToRva(uint64_t va) const {
+  if (va < imageBase || va - imageBase >= optionalHeader->SizeOfImage) return std::nullopt;
+  return (uint32_t) (va - imageBase);
+}
+
+char *Image::GetMapped(uint32_t rva, size_t size) {
+  auto section = SectionOf(rva);
+  if (!section) return nullptr;
+  uint64_t delta = rva - section->address, backed = std::min(section->size, section->rawSize);
+  if (delta >= backed || size > backed - delta) return nullptr;
+  return GetFileMapped(section->offset + delta, size);
+}
+
+char *Image::GetFileMapped(uint64_t offset, size_t size) {
+  if (offset > fileSize || size > fileSize - offset) return nullptr;
+  return base + offset;
+}
+
+std::string_view Image::GetString(uint32_t rva) {
+  auto section = SectionOf(rva);
+  if (!section) return {};
+  uint64_t delta = rva - section->address, backed = std::min(section->size, section->rawSize);
+  auto start     = delta < backed ? GetFileMapped(section->offset + delta, backed - delta) : nullptr;
+  if (!start) return {};
+  return {start, strnlen(start, backed - delta)};
+}
+
+// names point into the mapping, only the Symbol handed out owns a copy
+struct SymbolEntry {
+  std::string_view prefix, name;
+  uint32_t offset;
+};
+
+struct SymbolIterator : public ISymbolIterator {
+  std::vector<SymbolEntry> entries;
+  size_t it{};
+  virtual Symbol Get() override {
+    auto &entry = entries[it];
+    std::string name;
+    name.reserve(entry.prefix.size() + entry.name.size());
+    name.append(entry.prefix).append(entry.name);
+    return Symbol{.Name = std::move(name), .Offset = entry.offset};
+  }
+  virtual bool Next() override { return ++it < entries.size(); }
+};
+
+struct DumpSource : public IDumpSource {
+  Image image;
+
+  DumpSource(std::filesystem::path const &path) : image(path) {}
+
+  void AddExports(std::vector<SymbolEntry> &entries) {
+    auto directory = image.Directory(DIRECTORY_EXPORT);
+    auto exports   = (export_directory const *) image.GetMapped(directory.VirtualAddress, sizeof(export_directory));
+    if (!directory.Size || !exports) return;
+    auto functions = (uint32_t const *) image.GetMapped(
+        exports->AddressOfFunctions, sizeof(uint32_t) * (size_t) exports->NumberOfFunctions);
+    auto names =
+        (uint32_t const *) image.GetMapped(exports->AddressOfNames, sizeof(uint32_t) * (size_t) exports->NumberOfNames);
+    auto ordinals = (uint16_t const *) image.GetMapped(
+        exports->AddressOfNameOrdinals, sizeof(uint16_t) * (size_t) exports->NumberOfNames);
+    if (!functions || !names || !ordinals) return;
+    for (uint32_t i = 0; i < exports->NumberOfNames; i++) {
+      if (ordinals[i] >= exports->NumberOfFunctions) continue;
+      auto rva = functions[ordinals[i]];
+      // forwarders point to a "dll.name" string inside the directory instead of code
+      if (rva - directory.VirtualAddress < directory.Size) continue;
+      if (auto name = image.GetString(names[i]); !name.empty()) entries.push_back({{}, name, rva});
+    }
+  }
+
+  void AddImports(std::vector<SymbolEntry> &entries) {
+    auto directory = image.Directory(DIRECTORY_IMPORT);
+    for (uint32_t at = directory.VirtualAddress; directory.Size; at += sizeof(import_descriptor)) {
+      auto descriptor = (import_descriptor const *) image.GetMapped(at, sizeof(import_descriptor));
+      if (!descriptor || !descriptor->Name) break;
+      // bound images overwrite the address table, the lookup table keeps the names
+      auto lookup = descriptor->OriginalFirstThunk ? descriptor->OriginalFirstThunk : descriptor->FirstThunk;
+      for (uint32_t i = 0;; i++) {
+        auto thunk = (uint64_t const *) image.GetMapped(lookup + i * 8, sizeof(uint64_t));
+        if (!thunk || !*thunk) break;
+        if (*thunk >> 63) continue; // by ordinal, no name
+        // hint then the name
+        auto name = image.GetString((uint32_t) *thunk + 2);
+        if (!name.empty()) entries.push_back({"__imp_", name, descriptor->FirstThunk + i * 8});
+      }
+    }
+  }
+
+  void AddCoffSymbols(std::vector<SymbolEntry> &entries) {
+    auto &header = image.FileHeader();
+    if (!header.PointerToSymbolTable) return;
+    auto symbols = (coff_symbol const *) image.GetFileMapped(
+        header.PointerToSymbolTable, sizeof(coff_symbol) * (size_t) header.NumberOfSymbols);
+    if (!symbols) return;
+    uint64_t stringTable = header.PointerToSymbolTable + sizeof(coff_symbol) * (uint64_t) header.NumberOfSymbols;
+    auto stringSize      = (uint32_t const *) image.GetFileMapped(stringTable, sizeof(uint32_t));
+    for (uint32_t i = 0; i < header.NumberOfSymbols; i += 1 + symbols[i].NumberOfAuxSymbols) {
+      auto &symbol = symbols[i];
+      // aux records running past the table mean it is truncated, nothing after this symbol can be trusted
+      if (symbol.NumberOfAuxSymbols >= header.NumberOfSymbols - i) break;
+      auto section = image.SectionByNumber(symbol.SectionNumber);
+      if (!section) continue;
+      if (symbol.StorageClass != SYM_CLASS_EXTERNAL && symbol.StorageClass != SYM_CLASS_STATIC) continue;
+      std::string_view name;
+      if (symbol.LongName.Zeroes) {
+        name = {symbol.ShortName, strnlen(symbol.ShortName, sizeof symbol.ShortName)};
+      } else if (stringSize && symbol.LongName.Offset < *stringSize) {
+        auto start = image.GetFileMapped(stringTable + symbol.LongName.Offset, *stringSize - symbol.LongName.Offset);
+        if (start) name = {start, strnlen(start, *stringSize - symbol.LongName.Offset)};
+      }
+      // section definitions
+      if (name.empty() || name[0] == '.') continue;
+      entries.push_back({{}, name, section->address + symbol.Value});
+    }
+  }
+
+  virtual std::unique_ptr<ISymbolIterator> GetIterator() override {
+    auto ret = std::make_unique<SymbolIterator>();
+    AddExports(ret->entries);
+    AddImports(ret->entries);
+    AddCoffSymbols(ret->entries);
+    if (ret->entries.empty()) return nullptr;
+    return ret;
+  }
+};
+
+class SymbolDumper : public ISymbolDumper {
+public:
+  virtual std::unique_ptr<IDumpSource> Open(std::filesystem::path const &path) override {
+    return std::make_unique<DumpSource>(path);
+  }
+};
+
+ISymbolDumper &GetDumper() {
+  static SymbolDumper ret;
+  return ret;
+}
+
+// every class named by a locator, with the direct bases picked out of the flattened base array
+static std::optional<RttiClass> ReadClass(Image &image, rtti_complete_object_locator const &col) {
+  auto chd = (rtti_class_hierarchy_descriptor const *) image.GetMapped(
+      col.pClassDescriptor, sizeof(rtti_class_hierarchy_descriptor));
+  if (!chd || chd->numBaseClasses == 0 || chd->numBaseClasses > 0x10000) return std::nullopt;
+  auto array = (int32_t const *) image.GetMapped(chd->pBaseClassArray, sizeof(int32_t) * chd->numBaseClasses);
+  if (!array) return std::nullopt;
+  RttiClass ret{
+      .typeDescriptor = (uint32_t) col.pTypeDescriptor,
+      .attributes     = chd->attributes,
+      .name = std::string{image.GetString(col.pTypeDescriptor + (uint32_t) sizeof(rtti_type_descriptor))}};
+  for (uint32_t i = 1; i < chd->numBaseClasses;) {
+    auto bcd = (rtti_base_class_descriptor const *) image.GetMapped(array[i], sizeof(rtti_base_class_descriptor));
+    if (!bcd) return std::nullopt;
+    ret.bases.push_back({(uint32_t) bcd->pTypeDescriptor, bcd->mdisp, bcd->pdisp, bcd->vdisp, bcd->attributes});
+    i += 1 + bcd->numContainedBases;
+  }
+  return ret;
+}
+
+Rtti ScanRtti(Image &image, unsigned threads) {
+  struct Chunk {
+    uint32_t begin, end;
+  };
+  constexpr uint32_t ChunkSize = 1 << 20;
+  std::vector<Chunk> chunks;
+  for (auto &section : image.Sections()) {
+    if (section.characteristics & SCN_MEM_EXECUTE) continue;
+    auto end = section.address + std::min(section.size, section.rawSize);
+    for (auto begin = section.address; begin < end; begin += ChunkSize)
+      chunks.push_back({begin, std::min(end, begin + ChunkSize)});
+  }
+
+  struct Part {
+    std::vector<uint32_t> locators;
+    std::vector<RttiVtable> vtables;
+    std::vector<RttiClass> classes;
+  };
+  if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<Part> parts(threads);
+  auto isFunction = [&](uint32_t rva) {
+    auto slot = (uint64_t const *) image.GetMapped(rva, sizeof(uint64_t));
+    if (!slot) return std::optional<uint32_t>{};
+    auto target = image.ToRva(*slot);
+    return target && image.IsExecutable(*target) ? target : std::nullopt;
+  };
+  ParallelFor(
+      chunks.size(),
+      [&](unsigned slice, size_t first, size_t last) {
+        auto &part = parts[slice];
+        for (auto idx = first; idx < last; idx++) {
+          auto [begin, end] = chunks[idx];
+          for (auto rva = (begin + 3) & ~3u; rva < end; rva += 4) {
+            if (auto col = (rtti_complete_object_locator const *) image.GetMapped(
+                    rva, sizeof(rtti_complete_object_locator));
+                col && col->signature == 1 && (uint32_t) col->pSelf == rva) {
+              part.locators.push_back(rva);
+              if (auto cls = ReadClass(image, *col)) part.classes.emplace_back(std::move(*cls));
+            }
+            if (rva & 7) continue;
+            // a vftable starts right after the pointer to its locator
+            auto slot = (uint64_t const *) image.GetMapped(rva, sizeof(uint64_t));
+            auto meta = slot ? image.ToRva(*slot) : std::nullopt;
+            if (!meta || image.IsExecutable(*meta) || !isFunction(rva + 8)) continue;
+            RttiVtable vtable{.address = rva + 8, .locator = *meta};
+            for (auto at = rva + 8; auto target = isFunction(at); at += 8) vtable.slots.push_back(*target);
+            part.vtables.emplace_back(std::move(vtable));
+          }
+        }
+      },
+      threads);
+
+  std::vector<uint32_t> locators;
+  Rtti ret;
+  for (auto &part : parts) {
+    locators.insert(locators.end(), part.locators.begin(), part.locators.end());
+    std::move(part.vtables.begin(), part.vtables.end(), std::back_inserter(ret.vtables));
+    std::move(part.classes.begin(), part.classes.end(), std::back_inserter(ret.classes));
+  }
+  std::sort(locators.begin(), locators.end());
+  std::erase_if(ret.vtables, [&](RttiVtable &vtable) {
+    if (!std::binary_search(locators.begin(), locators.end(), vtable.locator)) return true;
+    auto col =
+        (rtti_complete_object_locator const *) image.GetMapped(vtable.locator, sizeof(rtti_complete_object_locator));
+    vtable.offset         = col->offset;
+    vtable.typeDescriptor = (uint32_t) col->pTypeDescriptor;
+    return false;
+  });
+  std::sort(ret.vtables.begin(), ret.vtables.end(), [](RttiVtable const &a, RttiVtable const &b) {
+    return a.address < b.address;
+  });
+  std::stable_sort(ret.classes.begin(), ret.classes.end(), [](RttiClass const &a, RttiClass const &b) {
+    return a.typeDescriptor < b.typeDescriptor;
+  });
+  ret.classes.erase(
+      std::unique(
+          ret.classes.begin(), ret.classes.end(),
+          [](RttiClass const &a, RttiClass const &b) { return a.typeDescriptor == b.typeDescriptor; }),
+      ret.classes.end());
+  return ret;
+}
+
+} // namespace pe
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <windowscommon.h>
+
+// Read only symbol index, an alternative to the sqlite database for pure lookup workloads.
+// The file is used straight from the mapping, opening it only checks the header and the block table,
+// the contents are trusted unless Verify() is called.
+//
+// Layout (little endian, every section 8 byte aligned):
+//   Header
+//   names      front coded blocks of block_size names, sorted like symbols.key
+//   blocks     uint64_t start of every block in names
+//   offsets    uint64_t per symbol, in name order
+//   sizes      uint64_t per symbol, 0 when unknown
+//   kinds      uint8_t per symbol (adapter::RootKind)
+//   originals  uint8_t per symbol (1 windows, 2 linux)
+//   addresses  AddressEntry sorted by original then offset
+//
+// A block starts with a full name (varint length, bytes), every following name is stored as
+// varint shared prefix length, varint suffix length, suffix bytes.
+namespace symindex {
+
+constexpr char Magic[8]         = {'B', 'D', 'S', 'D', 'S', 'I', 'D', 'X'};
+constexpr uint32_t Version      = 2;
+constexpr uint32_t DefaultBlock = 16;
+
+struct Section {
+  uint64_t offset, size, checksum;
+};
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t block_size;
+  uint64_t count;
+  Section names, blocks, offsets, sizes, kinds, originals, addresses;
+  uint64_t checksum; // of every field above
+};
+
+struct AddressEntry {
+  uint64_t offset;
+  uint32_t original;
+  uint32_t id;
+};
+
+// fnv-1a
+inline uint64_t checksum(void const *data, size_t size) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (auto it = (uint8_t const *) data, end = it + size; it != end; it++) hash = (hash ^ *it) * 0x100000001b3;
+  return hash;
+}
+
+class Writer {
+  uint32_t block_size;
+  uint64_t count = 0;
+  std::string names, last;
+  std::vector<uint64_t> blocks, offsets, sizes;
+  std::vector<uint8_t> kinds, originals;
+
+public:
+  Writer(uint32_t block_size = DefaultBlock) : block_size(block_size) {}
+
+  // names must come in non decreasing order
+  void Add(std::string_view name, uint64_t offset, uint64_t size, uint8_t kind, uint8_t original);
+  void Write(std::filesystem::path const &path) const;
+};
+
+class Reader {
+  common::WindowsFileMapping map;
+  common::MappingView<char> view;
+  char const *base;
+  Header const *header;
+
+  template <typename T> T const *Get(Section const &section) const { return (T const *) (base + section.offset); }
+
+  uint32_t LowerBound(std::string_view key) const;
+
+public:
+  struct Hit {
+    uint32_t id;
+    uint64_t delta;
+  };
+
+  // throws std::runtime_error when the file is not a valid index
+  Reader(std::filesystem::path const &path);
+
+  // checks the section checksums, which reads the whole file
+  bool Verify() const;
+
+  uint32_t Count() const { return (uint32_t) header->count; }
+  std::string Name(uint32_t id) const;
+  uint64_t Offset(uint32_t id) const { return Get<uint64_t>(header->offsets)[id]; }
+  uint64_t Size(uint32_t id) const { return Get<uint64_t>(header->sizes)[id]; }
+  uint8_t Kind(uint32_t id) const { return Get<uint8_t>(header->kinds)[id]; }
+  uint8_t Original(uint32_t id) const { return Get<uint8_t>(header->originals)[id]; }
+
+  // first symbol named exactly name
+  std::optional<uint32_t> Find(std::string_view name) const;
+  // ids of the symbols starting with prefix, as [first, last)
+  std::pair<uint32_t, uint32_t> Prefix(std::string_view prefix) const;
+  // symbol of the given original containing address,
+  // a symbol without size extends up to the next one and the last one only covers its own address
+  std::optional<Hit> Symbolize(uint8_t original, uint64_t address) const;
+};
+
+} // namespace symindex
@@ -0,0 +1,135 @@
+#include "include/symindex.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+namespace symindex {
+
+static uint64_t GetVarint(char const *&ptr) {
+  uint64_t value = 0;
+  int shift      = 0;
+  while (*ptr & 0x80) {
+    value |= (uint64_t) (*ptr++ & 0x7f) << shift;
+    shift += 7;
+  }
+  value |= (uint64_t) (uint8_t) *ptr++ << shift;
+  return value;
+}
+
+// walks the names of one front coded block
+struct BlockCursor {
+  char const *ptr;
+  std::string name;
+
+  BlockCursor(char const *ptr) : ptr(ptr) {
+    auto len = GetVarint(this->ptr);
+    name.assign(this->ptr, len);
+    this->ptr += len;
+  }
+
+  void Next() {
+    auto shared = GetVarint(ptr);
+    auto len    = GetVarint(ptr);
+    name.resize(shared);
+    name.append(ptr, len);
+    ptr += len;
+  }
+};
+
+Reader::Reader(std::filesystem::path const &path) : map(path), view(map) {
+  base        = view.begin();
+  header      = (Header const *) base;
+  auto length = std::filesystem::file_size(path);
+  if (length < sizeof(Header) || memcmp(header->magic, Magic, sizeof Magic) != 0 || header->version != Version ||
+      header->checksum != checksum(header, offsetof(Header, checksum)) || header->block_size == 0)
+    throw std::runtime_error{"Not a symbol index"};
+  for (auto section : {&header->names, &header->blocks, &header->offsets, &header->sizes, &header->kinds,
+                       &header->originals, &header->addresses})
+    if (section->offset > length || section->size > length - section->offset)
+      throw std::runtime_error{"Truncated symbol index"};
+  auto count = header->count;
+  if (header->blocks.size != (count + header->block_size - 1) / header->block_size * sizeof(uint64_t) ||
+      header->offsets.size != count * sizeof(uint64_t) || header->sizes.size != count * sizeof(uint64_t) ||
+      header->kinds.size != count || header->originals.size != count ||
+      header->addresses.size != count * sizeof(AddressEntry))
+    throw std::runtime_error{"Corrupted symbol index"};
+  // every lookup starts from a block, the names inside them are only covered by Verify
+  auto blocks = Get<uint64_t>(header->blocks);
+  for (uint64_t i = 0, n = header->blocks.size / sizeof(uint64_t); i < n; i++)
+    if (blocks[i] >= header->names.size || (i ? blocks[i] <= blocks[i - 1] : blocks[i] != 0))
+      throw std::runtime_error{"Corrupted symbol index"};
+}
+
+bool Reader::Verify() const {
+  for (auto section : {&header->names, &header->blocks, &header->offsets, &header->sizes, &header->kinds,
+                       &header->originals, &header->addresses})
+    if (checksum(base + section->offset, section->size) != section->checksum) return false;
+  return true;
+}
+
+std::string Reader::Name(uint32_t id) const {
+  BlockCursor cursor{Get<char>(header->names) + Get<uint64_t>(header->blocks)[id / header->block_size]};
+  for (uint32_t i = id % header->block_size; i; i--) cursor.Next();
+  return std::move(cursor.name);
+}
+
+uint32_t Reader::LowerBound(std::string_view key) const {
+  auto names  = Get<char>(header->names);
+  auto blocks = Get<uint64_t>(header->blocks);
+  auto first  = [&](size_t block) {
+    auto ptr = names + blocks[block];
+    auto len = GetVarint(ptr);
+    return std::string_view{ptr, len};
+  };
+  // first block starting at or after key, the answer is in the block before it or is its first name
+  size_t lo = 0, hi = header->blocks.size / sizeof(uint64_t);
+  while (lo < hi) {
+    auto mid = (lo + hi) / 2;
+    if (first(mid) < key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo == 0) return 0;
+  auto block = lo - 1;
+  auto id    = block * header->block_size;
+  auto end   = std::min<uint64_t>(header->count, id + header->block_size);
+  BlockCursor cursor{names + blocks[block]};
+  for (id++; id < end; id++) {
+    cursor.Next();
+    if (cursor.name >= key) break;
+  }
+  return (uint32_t) id;
+}
+
+std::optional<uint32_t> Reader::Find(std::string_view name) const {
+  auto id = LowerBound(name);
+  if (id < header->count && Name(id) == name) return id;
+  return std::nullopt;
+}
+
+std::pair<uint32_t, uint32_t> Reader::Prefix(std::string_view prefix) const {
+  // the smallest string greater than everything starting with prefix
+  std::string next{prefix};
+  while (!next.empty() && (uint8_t) next.back() == 0xff) next.pop_back();
+  if (next.empty()) return {LowerBound(prefix), Count()};
+  next.back()++;
+  return {LowerBound(prefix), LowerBound(next)};
+}
+
+std::optional<Reader::Hit> Reader::Symbolize(uint8_t original, uint64_t address) const {
+  auto begin = Get<AddressEntry>(header->addresses);
+  auto end   = begin + header->count;
+  auto it    = std::upper_bound(begin, end, std::pair{(uint32_t) original, address}, [](auto const &key, auto const &e) {
+    return key.first != e.original ? key.first < e.original : key.second < e.offset;
+  });
+  if (it == begin || (--it)->original != original) return std::nullopt;
+  auto size = Size(it->id);
+  if (size == 0) size = it + 1 != end && (it + 1)->original == original ? (it + 1)->offset - it->offset : 1;
+  if (address - it->offset >= size) return std::nullopt;
+  return Hit{it->id, address - it->offset};
+}
+
+} // namespace symindex
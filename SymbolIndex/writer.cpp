@@ -0,0 +1,79 @@
+#include "include/symindex.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace symindex {
+
+static void PutVarint(std::string &out, uint64_t value) {
+  while (value >= 0x80) {
+    out += (char) (value | 0x80);
+    value >>= 7;
+  }
+  out += (char) value;
+}
+
+void Writer::Add(std::string_view name, uint64_t offset, uint64_t size, uint8_t kind, uint8_t original) {
+  if (name < last) throw std::runtime_error{"Symbol index names must be sorted"};
+  if (count % block_size == 0) {
+    blocks.push_back(names.size());
+    PutVarint(names, name.size());
+    names.append(name);
+  } else {
+    auto shared = (size_t) (std::mismatch(name.begin(), name.end(), last.begin(), last.end()).first - name.begin());
+    PutVarint(names, shared);
+    PutVarint(names, name.size() - shared);
+    names.append(name.substr(shared));
+  }
+  last = name;
+  offsets.push_back(offset);
+  sizes.push_back(size);
+  kinds.push_back(kind);
+  originals.push_back(original);
+  count++;
+}
+
+void Writer::Write(std::filesystem::path const &path) const {
+  std::vector<AddressEntry> addresses;
+  addresses.reserve(count);
+  for (uint32_t i = 0; i < count; i++) addresses.push_back({offsets[i], originals[i], i});
+  std::sort(addresses.begin(), addresses.end(), [](AddressEntry const &a, AddressEntry const &b) {
+    if (a.original != b.original) return a.original < b.original;
+    if (a.offset != b.offset) return a.offset < b.offset;
+    return a.id < b.id;
+  });
+
+  Header header{};
+  memcpy(header.magic, Magic, sizeof Magic);
+  header.version    = Version;
+  header.block_size = block_size;
+  header.count      = count;
+
+  std::string body;
+  auto put = [&](Section &section, void const *data, size_t size) {
+    section.offset   = sizeof(Header) + body.size();
+    section.size     = size;
+    section.checksum = checksum(data, size);
+    body.append((char const *) data, size);
+    body.resize((body.size() + 7) & ~(size_t) 7, '\0');
+  };
+  put(header.names, names.data(), names.size());
+  put(header.blocks, blocks.data(), blocks.size() * sizeof(uint64_t));
+  put(header.offsets, offsets.data(), offsets.size() * sizeof(uint64_t));
+  put(header.sizes, sizes.data(), sizes.size() * sizeof(uint64_t));
+  put(header.kinds, kinds.data(), kinds.size());
+  put(header.originals, originals.data(), originals.size());
+  put(header.addresses, addresses.data(), addresses.size() * sizeof(AddressEntry));
+  header.checksum = checksum(&header, offsetof(Header, checksum));
+
+  std::ofstream ofs{path, std::ios::binary | std::ios::trunc};
+  if (!ofs) throw std::runtime_error{"Failed to create " + path.string()};
+  ofs.write((char const *) &header, sizeof header);
+  ofs.write(body.data(), body.size());
+  if (!ofs) throw std::runtime_error{"Failed to write " + path.string()};
+}
+
+} // namespace symindex
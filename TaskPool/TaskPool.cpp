@@ -1,6 +1,12 @@
 #include "TaskPool.h"
 
-TaskPool::TaskPool() : thread{std::bind_front(&TaskPool::Worker, this)} {}
+#include <algorithm>
+#include <exception>
+#include <latch>
+
+TaskPool::TaskPool(unsigned count) {
+  for (unsigned i = 0; i < count; i++) threads.emplace_back(std::bind_front(&TaskPool::Worker, this));
+}
 
 TaskPool::~TaskPool() {
   {
@@ -8,7 +14,8 @@ TaskPool::~TaskPool() {
     stop = true;
   }
   cv.notify_all();
-  if (thread.joinable()) thread.join();
+  for (auto &thread : threads)
+    if (thread.joinable()) thread.join();
 }
 
 void TaskPool::AddTask(std::function<void()> &&fn) {
@@ -32,4 +39,28 @@ void TaskPool::Worker() {
     else
       cv.wait(lock);
   }
-}
\ No newline at end of file
+}
+
+void TaskPool::ParallelFor(size_t count, std::function<void(unsigned, size_t, size_t)> const &fn) {
+  auto workers = Size();
+  auto per     = (count + workers - 1) / workers;
+  std::vector<std::exception_ptr> errors(workers);
+  std::latch done{(ptrdiff_t) workers};
+  for (unsigned w = 0; w < workers; w++) {
+    AddTask([&, w] {
+      try {
+        auto first = std::min(count, w * per), last = std::min(count, first + per);
+        fn(w, first, last);
+      } catch (...) { errors[w] = std::current_exception(); }
+      done.count_down();
+    });
+  }
+  done.wait();
+  for (auto &error : errors)
+    if (error) std::rethrow_exception(error);
+}
+
+void ParallelFor(size_t count, std::function<void(unsigned, size_t, size_t)> const &fn, unsigned workers) {
+  TaskPool pool{workers ? workers : std::max(1u, std::thread::hardware_concurrency())};
+  pool.ParallelFor(count, fn);
+}
@@ -3,20 +3,30 @@
 #include <condition_variable>
 #include <mutex>
 #include <queue>
+#include <vector>
 #include <optional>
 #include <functional>
 
 class TaskPool {
   bool stop = false;
   std::mutex mtx;
-  std::thread thread;
+  std::vector<std::thread> threads;
   std::condition_variable cv;
   std::queue<std::function<void()>> tasks;
 
   void Worker();
 
 public:
-  TaskPool();
+  TaskPool(unsigned count = 1);
   ~TaskPool();
   void AddTask(std::function<void()> &&);
-};
\ No newline at end of file
+
+  unsigned Size() const { return (unsigned) threads.size(); }
+  // splits [0, count) into one contiguous slice per worker, runs fn(slice, first, last) for each and waits for them.
+  // the first exception thrown by a slice is rethrown once every slice is done. must not be called from a worker.
+  void ParallelFor(size_t count, std::function<void(unsigned slice, size_t first, size_t last)> const &fn);
+};
+
+// TaskPool::ParallelFor on a pool of its own, with one worker per core when workers is 0
+void ParallelFor(
+    size_t count, std::function<void(unsigned slice, size_t first, size_t last)> const &fn, unsigned workers = 0);
@@ -13,6 +13,7 @@ class DumpError : std::runtime_error {
 struct Symbol {
   std::string Name;
   uint64_t Offset;
+  uint64_t Size{};
 };
 
 class ISymbolIterator {
@@ -0,0 +1,470 @@
+#include "SymbolExtension.h"
+#include <elf.h>
+#include <pe.h>
+#include <pdb.h>
+#include <ItaniumDemangle.h>
+#include <MicrosoftDemangle.h>
+#include <adapter.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// elf_symbols, elf_sections, elf_relocations: the tables of a binary read straight from its mapping
+//
+//   SELECT * FROM elf_symbols('bedrock_server') WHERE offset BETWEEN 0x1000 AND 0x2000;
+//   SELECT decoded FROM elf_symbols('bedrock_server') WHERE name GLOB '_ZN5Actor*';
+//   SELECT * FROM elf_relocations('bedrock_server') WHERE offset >= 0x5000 LIMIT 10;
+//   SELECT * FROM elf_sections('bedrock_server');
+//
+// symbols also come from a pdb or a pe image, relocations only from an elf. The last few binaries are kept per
+// connection and reloaded when the file changes. The tables can only be used directly, not from a schema. Offset ranges, name ranges and glob prefixes are turned into
+// binary searches over the offset or name order, the constraints are still checked by sqlite afterwards.
+// decoded is only demangled for the rows it is read from.
+
+namespace {
+
+std::string decode(std::string_view name) {
+  std::ostringstream oss;
+  if (name.starts_with("_Z")) {
+    llvm::itanium_demangle::ManglingParser<llvm::itanium_demangle::DefaultAllocator> parser{
+        name.data(), name.data() + name.size()};
+    if (auto node = parser.parse()) {
+      oss << *adapter::Adapt(*node);
+      return oss.str();
+    }
+  } else if (name.starts_with("?")) {
+    llvm::ms_demangle::Demangler dem{};
+    llvm::StringView sv{name.data(), name.data() + name.size()};
+    if (auto node = dem.parse(sv)) {
+      oss << *adapter::Adapt(*node);
+      return oss.str();
+    }
+  }
+  return std::string{name};
+}
+
+struct Binary {
+  struct Symbol {
+    std::string_view name;
+    uint64_t offset, size;
+  };
+
+  std::filesystem::file_time_type time;
+  bool isElf = false;
+  std::unique_ptr<common::IDumpSource> source;
+  // names of elf symbols point into the mapped .dynstr, the ones of other sources into owned
+  std::optional<elf::SectionData> dynstr;
+  std::vector<std::string> owned;
+  std::vector<Symbol> symbols;  // sorted by offset
+  std::vector<uint32_t> byName; // indices of symbols sorted by name
+  std::vector<elf::SectionHeader> sections;
+  std::optional<elf::RelocationIndex> relocations; // built on first use
+  std::vector<std::string_view> dynamicNames;     // by .dynsym index
+
+  explicit Binary(std::filesystem::path const &path) : time(std::filesystem::last_write_time(path)) {
+    char sig[4]{};
+    std::ifstream{path, std::ios::binary}.read(sig, 4);
+    if (memcmp(sig, "\x7F" "ELF", 4) == 0) {
+      isElf        = true;
+      source       = elf::GetDumper().Open(path);
+      auto &dumper = *(elf::IElfDumpSource *) source.get();
+      dynstr       = dumper.GetSection(".dynstr");
+      auto dynsym  = dumper.GetSection(".dynsym");
+      if (!dynstr || !dynsym) throw std::runtime_error{"Failed to load .dynsym section"};
+      dynstr->diff = 0;
+      common::MappingView<elf::symbol_data> esyms = std::move(dynsym->data);
+      for (auto &sym : esyms) {
+        auto str = dynstr->GetMapped(sym.st_name);
+        std::string_view name{str ? str : ""};
+        dynamicNames.push_back(name);
+        if (sym.st_value) symbols.push_back({name, sym.st_value, sym.st_size});
+      }
+      sections = dumper.GetSectionHeaders();
+    } else {
+      bool isPe = memcmp(sig, "MZ", 2) == 0;
+      if (!isPe && memcmp(sig, "Micr", 4) != 0)
+        throw std::runtime_error{"Unknown binary, expect an elf, a pdb or a pe"};
+      source  = (isPe ? pe::GetDumper() : pdb::GetDumper()).Open(path);
+      auto it = source->GetIterator();
+      std::vector<std::pair<uint64_t, uint64_t>> ranges;
+      if (it) {
+        do {
+          auto sym = it->Get();
+          if (!sym.Offset) continue;
+          owned.emplace_back(std::move(sym.Name));
+          ranges.emplace_back(sym.Offset, sym.Size);
+        } while (it->Next());
+      }
+      // owned does not grow anymore, the views stay valid
+      for (size_t i = 0; i < owned.size(); i++) symbols.push_back({owned[i], ranges[i].first, ranges[i].second});
+      if (isPe) {
+        pe::Image image{path};
+        for (auto &section : image.Sections())
+          sections.emplace_back(section.name, section.address, section.offset, section.size);
+      }
+    }
+    std::stable_sort(symbols.begin(), symbols.end(), [](Symbol const &a, Symbol const &b) {
+      return a.offset < b.offset;
+    });
+    byName.resize(symbols.size());
+    for (uint32_t i = 0; i < byName.size(); i++) byName[i] = i;
+    std::stable_sort(byName.begin(), byName.end(), [&](uint32_t a, uint32_t b) {
+      return symbols[a].name < symbols[b].name;
+    });
+  }
+
+  elf::RelocationIndex const &Relocations() {
+    if (!relocations) {
+      if (isElf)
+        relocations.emplace(*(elf::IElfDumpSource *) source.get());
+      else
+        relocations.emplace();
+    }
+    return *relocations;
+  }
+};
+
+enum Kind { KIND_SYMBOLS, KIND_SECTIONS, KIND_RELOCATIONS };
+
+char const *schemas[] = {
+    "CREATE TABLE x(name TEXT, decoded TEXT, offset INT, size INT, path HIDDEN)",
+    "CREATE TABLE x(name TEXT, address INT, offset INT, size INT, path HIDDEN)",
+    "CREATE TABLE x(offset INT, target INT, symbol TEXT, type INT, path HIDDEN)",
+};
+
+// column of the offset and of the name in every kind, -1 when there is none
+constexpr int offsetColumn[] = {2, -1, 0};
+constexpr int nameColumn[]   = {0, -1, -1};
+constexpr int pathColumn     = 4;
+
+// pushed down constraints, bit n of idxNum is set when slot n is used and the arguments follow the slot order
+enum Slot { SLOT_PATH, SLOT_OFFSET_LO, SLOT_OFFSET_HI, SLOT_NAME_LO, SLOT_NAME_HI, SLOT_NAME_GLOB, SLOT_COUNT };
+// rows are walked in name order
+constexpr int ByName = 1 << SLOT_COUNT;
+// the lower bound is an equality and bounds the walk from above too
+constexpr int OffsetEq = 1 << (SLOT_COUNT + 1);
+constexpr int NameEq   = 1 << (SLOT_COUNT + 2);
+
+// binaries kept per table, cursors still walking an evicted one keep it alive
+constexpr size_t MaxCached = 4;
+
+struct BinaryTable : sqlite3_vtab {
+  Kind kind;
+  std::map<std::string, std::shared_ptr<Binary>> cache;
+
+  std::shared_ptr<Binary> Load(std::string const &path) {
+    std::filesystem::path file{std::u8string{path.begin(), path.end()}};
+    if (cache.size() >= MaxCached && !cache.contains(path)) cache.clear();
+    auto &slot = cache[path];
+    if (!slot || slot->time != std::filesystem::last_write_time(file)) slot = std::make_shared<Binary>(file);
+    return slot;
+  }
+};
+
+struct BinaryCursor : sqlite3_vtab_cursor {
+  std::shared_ptr<Binary> binary;
+  bool byName = false;
+  size_t pos = 0, end = 0;
+  // upper bounds checked while walking, the lower ones are where the walk starts
+  std::optional<uint64_t> offsetHi;
+  std::optional<std::string> nameHi, prefix;
+
+  Kind kind() const { return ((BinaryTable *) pVtab)->kind; }
+
+  size_t count() const {
+    switch (kind()) {
+    case KIND_SYMBOLS: return binary->symbols.size();
+    case KIND_SECTIONS: return binary->sections.size();
+    case KIND_RELOCATIONS: return binary->Relocations().size();
+    }
+    return 0;
+  }
+
+  Binary::Symbol const &symbol() const { return binary->symbols[byName ? binary->byName[pos] : pos]; }
+
+  // stops at the first row past an upper bound, rows are visited in the order the bound is on
+  void check() {
+    if (pos >= end) return;
+    if (byName) {
+      auto name = symbol().name;
+      if ((nameHi && name > *nameHi) || (prefix && !name.starts_with(*prefix))) end = pos;
+    } else if (offsetHi) {
+      auto offset = kind() == KIND_SYMBOLS ? symbol().offset : binary->Relocations()[pos].offset;
+      if (offset > *offsetHi) end = pos;
+    }
+  }
+};
+
+int binaryConnect(sqlite3 *db, void *aux, int, const char *const *, sqlite3_vtab **ppVtab, char **) {
+  auto kind = (Kind) (intptr_t) aux;
+  int rc    = sqlite3_declare_vtab(db, schemas[kind]);
+  // reads any file it is given, so views and triggers stored in an opened database must not reach it
+  if (rc == SQLITE_OK) rc = sqlite3_vtab_config(db, SQLITE_VTAB_DIRECTONLY);
+  if (rc != SQLITE_OK) return rc;
+  auto table  = new BinaryTable{};
+  table->kind = kind;
+  *ppVtab     = table;
+  return SQLITE_OK;
+}
+
+int binaryDisconnect(sqlite3_vtab *pVtab) {
+  delete (BinaryTable *) pVtab;
+  return SQLITE_OK;
+}
+
+int binaryBestIndex(sqlite3_vtab *pVtab, sqlite3_index_info *info) {
+  auto kind = ((BinaryTable *) pVtab)->kind;
+  int used[SLOT_COUNT];
+  std::fill(std::begin(used), std::end(used), -1);
+  for (int i = 0; i < info->nConstraint; i++) {
+    auto &c = info->aConstraint[i];
+    if (c.iColumn == pathColumn && c.op == SQLITE_INDEX_CONSTRAINT_EQ) {
+      if (!c.usable) return SQLITE_CONSTRAINT;
+      used[SLOT_PATH] = i;
+      continue;
+    }
+    if (!c.usable) continue;
+    bool lo = c.op == SQLITE_INDEX_CONSTRAINT_EQ || c.op == SQLITE_INDEX_CONSTRAINT_GT ||
+              c.op == SQLITE_INDEX_CONSTRAINT_GE;
+    bool hi = c.op == SQLITE_INDEX_CONSTRAINT_EQ || c.op == SQLITE_INDEX_CONSTRAINT_LT ||
+              c.op == SQLITE_INDEX_CONSTRAINT_LE;
+    // a constraint only feeds one argument, an equality goes to the lower bound and is flagged
+    if (c.iColumn == offsetColumn[kind]) {
+      if (lo && (used[SLOT_OFFSET_LO] < 0 || c.op == SQLITE_INDEX_CONSTRAINT_EQ)) {
+        used[SLOT_OFFSET_LO] = i;
+        if (c.op == SQLITE_INDEX_CONSTRAINT_EQ) info->idxNum |= OffsetEq;
+      } else if (hi && !lo)
+        used[SLOT_OFFSET_HI] = i;
+    } else if (c.iColumn == nameColumn[kind]) {
+      if (lo && (used[SLOT_NAME_LO] < 0 || c.op == SQLITE_INDEX_CONSTRAINT_EQ)) {
+        used[SLOT_NAME_LO] = i;
+        if (c.op == SQLITE_INDEX_CONSTRAINT_EQ) info->idxNum |= NameEq;
+      } else if (hi && !lo)
+        used[SLOT_NAME_HI] = i;
+      else if (c.op == SQLITE_INDEX_CONSTRAINT_GLOB)
+        used[SLOT_NAME_GLOB] = i;
+    }
+  }
+  if (used[SLOT_PATH] < 0) return SQLITE_CONSTRAINT;
+
+  bool offsets = used[SLOT_OFFSET_LO] >= 0 || used[SLOT_OFFSET_HI] >= 0;
+  bool names   = used[SLOT_NAME_LO] >= 0 || used[SLOT_NAME_HI] >= 0 || used[SLOT_NAME_GLOB] >= 0;
+  // walk in the order of the constrained column, offset first, and only pass the bounds of that column
+  if (offsets) {
+    used[SLOT_NAME_LO] = used[SLOT_NAME_HI] = used[SLOT_NAME_GLOB] = -1;
+    info->idxNum &= ~NameEq;
+  }
+  bool byName = !offsets && names;
+  if (info->nOrderBy == 1 && !info->aOrderBy[0].desc && nameColumn[kind] >= 0 && !offsets &&
+      info->aOrderBy[0].iColumn == nameColumn[kind])
+    byName = true;
+
+  int argc = 0;
+  for (int i = 0; i < SLOT_COUNT; i++) {
+    if (used[i] < 0) continue;
+    info->aConstraintUsage[used[i]].argvIndex = ++argc;
+    info->aConstraintUsage[used[i]].omit      = i == SLOT_PATH;
+    info->idxNum |= 1 << i;
+  }
+  if (byName) info->idxNum |= ByName;
+
+  if (info->nOrderBy == 1 && !info->aOrderBy[0].desc) {
+    auto column = info->aOrderBy[0].iColumn;
+    if ((byName && column == nameColumn[kind]) || (!byName && column == offsetColumn[kind]))
+      info->orderByConsumed = 1;
+  }
+  info->estimatedCost = offsets || names ? 20 : 100000;
+  return SQLITE_OK;
+}
+
+int binaryOpen(sqlite3_vtab *, sqlite3_vtab_cursor **ppCursor) {
+  *ppCursor = new BinaryCursor{};
+  return SQLITE_OK;
+}
+
+int binaryClose(sqlite3_vtab_cursor *cur) {
+  delete (BinaryCursor *) cur;
+  return SQLITE_OK;
+}
+
+int binaryFilter(sqlite3_vtab_cursor *pCursor, int idxNum, const char *, int argc, sqlite3_value **argv) {
+  auto cursor = (BinaryCursor *) pCursor;
+  auto table  = (BinaryTable *) pCursor->pVtab;
+  cursor->binary.reset();
+  cursor->pos = cursor->end = 0;
+  cursor->offsetHi.reset();
+  cursor->nameHi.reset();
+  cursor->prefix.reset();
+
+  sqlite3_value *args[SLOT_COUNT]{};
+  for (int i = 0, n = 0; i < SLOT_COUNT; i++)
+    if (idxNum & (1 << i)) args[i] = argv[n++];
+  auto text = [](sqlite3_value *value) {
+    return std::string{(char const *) sqlite3_value_text(value), (size_t) sqlite3_value_bytes(value)};
+  };
+  // a bound that is not a number (or NULL) cannot narrow the walk, sqlite still filters the rows.
+  // offsets are unsigned, so the sign is kept here and handled by each bound instead of wrapping around
+  auto number = [](sqlite3_value *value) -> std::optional<int64_t> {
+    if (!value || sqlite3_value_numeric_type(value) != SQLITE_INTEGER) return std::nullopt;
+    return sqlite3_value_int64(value);
+  };
+  auto string = [&](sqlite3_value *value) -> std::optional<std::string> {
+    if (!value || sqlite3_value_type(value) != SQLITE_TEXT) return std::nullopt;
+    return text(value);
+  };
+  if (sqlite3_value_type(args[SLOT_PATH]) == SQLITE_NULL) return SQLITE_OK;
+
+  try {
+    cursor->binary = table->Load(text(args[SLOT_PATH]));
+    cursor->byName = idxNum & ByName;
+    cursor->end    = cursor->count();
+
+    auto &binary = *cursor->binary;
+    if (cursor->byName) {
+      auto names     = [&](uint32_t i) { return binary.symbols[i].name; };
+      auto lo        = string(args[SLOT_NAME_LO]);
+      cursor->nameHi = idxNum & NameEq ? lo : string(args[SLOT_NAME_HI]);
+      if (auto glob = string(args[SLOT_NAME_GLOB])) {
+        auto literal = glob->substr(0, glob->find_first_of("*?["));
+        if (!lo || literal > *lo) lo = literal;
+        cursor->prefix = std::move(literal);
+      }
+      if (lo)
+        cursor->pos = std::partition_point(binary.byName.begin(), binary.byName.end(), [&](uint32_t i) {
+                        return names(i) < *lo;
+                      }) - binary.byName.begin();
+    } else {
+      auto offsetAt = [&](size_t i) {
+        return table->kind == KIND_SYMBOLS ? binary.symbols[i].offset : binary.Relocations()[i].offset;
+      };
+      // a negative lower bound admits every offset
+      if (auto lo = number(args[SLOT_OFFSET_LO]); lo && *lo > 0 && table->kind != KIND_SECTIONS) {
+        size_t first = 0, len = cursor->end;
+        while (len > 0) {
+          auto half = len / 2;
+          if (offsetAt(first + half) < (uint64_t) *lo) {
+            first += half + 1;
+            len -= half + 1;
+          } else
+            len = half;
+        }
+        cursor->pos = first;
+      }
+      // and a negative upper bound none
+      if (auto hi = number(args[idxNum & OffsetEq ? SLOT_OFFSET_LO : SLOT_OFFSET_HI]); hi && *hi < 0)
+        cursor->end = cursor->pos;
+      else if (hi)
+        cursor->offsetHi = (uint64_t) *hi;
+    }
+    cursor->check();
+  } catch (std::exception const &e) {
+    sqlite3_free(table->zErrMsg);
+    table->zErrMsg = sqlite3_mprintf("%s", e.what());
+    return SQLITE_ERROR;
+  }
+  return SQLITE_OK;
+}
+
+int binaryNext(sqlite3_vtab_cursor *pCursor) {
+  auto cursor = (BinaryCursor *) pCursor;
+  cursor->pos++;
+  cursor->check();
+  return SQLITE_OK;
+}
+
+int binaryEof(sqlite3_vtab_cursor *pCursor) {
+  auto cursor = (BinaryCursor *) pCursor;
+  return cursor->pos >= cursor->end;
+}
+
+void resultText(sqlite3_context *ctx, std::string_view text) {
+  sqlite3_result_text(ctx, text.data(), (int) text.size(), SQLITE_TRANSIENT);
+}
+
+int binaryColumn(sqlite3_vtab_cursor *pCursor, sqlite3_context *ctx, int col) {
+  auto cursor  = (BinaryCursor *) pCursor;
+  auto &binary = *cursor->binary;
+  if (col == pathColumn) {
+    sqlite3_result_null(ctx);
+    return SQLITE_OK;
+  }
+  try {
+    switch (cursor->kind()) {
+    case KIND_SYMBOLS: {
+      auto &symbol = cursor->symbol();
+      switch (col) {
+      case 0: resultText(ctx, symbol.name); break;
+      case 1: resultText(ctx, decode(symbol.name)); break;
+      case 2: sqlite3_result_int64(ctx, (sqlite3_int64) symbol.offset); break;
+      case 3: sqlite3_result_int64(ctx, (sqlite3_int64) symbol.size); break;
+      }
+    } break;
+    case KIND_SECTIONS: {
+      auto &section = binary.sections[cursor->pos];
+      switch (col) {
+      case 0: resultText(ctx, section.name); break;
+      case 1: sqlite3_result_int64(ctx, (sqlite3_int64) section.address); break;
+      case 2: sqlite3_result_int64(ctx, (sqlite3_int64) section.offset); break;
+      case 3: sqlite3_result_int64(ctx, (sqlite3_int64) section.size); break;
+      }
+    } break;
+    case KIND_RELOCATIONS: {
+      auto relocation = binary.Relocations()[cursor->pos];
+      switch (col) {
+      case 0: sqlite3_result_int64(ctx, (sqlite3_int64) relocation.offset); break;
+      case 1: sqlite3_result_int64(ctx, (sqlite3_int64) relocation.target); break;
+      case 2:
+        if (relocation.symbol && relocation.symbol < binary.dynamicNames.size())
+          resultText(ctx, binary.dynamicNames[relocation.symbol]);
+        else
+          sqlite3_result_null(ctx);
+        break;
+      case 3: sqlite3_result_int(ctx, (int) relocation.type); break;
+      }
+    } break;
+    }
+  } catch (std::exception const &e) {
+    sqlite3_result_error(ctx, e.what(), -1);
+    return SQLITE_ERROR;
+  }
+  return SQLITE_OK;
+}
+
+int binaryRowid(sqlite3_vtab_cursor *pCursor, sqlite3_int64 *pRowid) {
+  auto cursor = (BinaryCursor *) pCursor;
+  *pRowid     = (sqlite3_int64) (cursor->byName ? cursor->binary->byName[cursor->pos] : cursor->pos);
+  return SQLITE_OK;
+}
+
+sqlite3_module binaryModule{
+    .iVersion    = 0,
+    .xCreate     = nullptr,
+    .xConnect    = binaryConnect,
+    .xBestIndex  = binaryBestIndex,
+    .xDisconnect = binaryDisconnect,
+    .xDestroy    = binaryDisconnect,
+    .xOpen       = binaryOpen,
+    .xClose      = binaryClose,
+    .xFilter     = binaryFilter,
+    .xNext       = binaryNext,
+    .xEof        = binaryEof,
+    .xColumn     = binaryColumn,
+    .xRowid      = binaryRowid,
+};
+
+} // namespace
+
+int elfvtab_register(sqlite3 *db) {
+  int rc = sqlite3_create_module(db, "elf_symbols", &binaryModule, (void *) (intptr_t) KIND_SYMBOLS);
+  if (rc == SQLITE_OK) rc = sqlite3_create_module(db, "elf_sections", &binaryModule, (void *) (intptr_t) KIND_SECTIONS);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_create_module(db, "elf_relocations", &binaryModule, (void *) (intptr_t) KIND_RELOCATIONS);
+  return rc;
+}
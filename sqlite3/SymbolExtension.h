@@ -0,0 +1,16 @@
+#pragma once
+
+// modules of the symbol extension living outside SymbolTokenizer.cpp
+
+#include "sqlite3ext.h"
+
+SQLITE_EXTENSION_INIT3
+
+// symfuzzy(query [, max]): vocabulary terms of fts_symbols within max edits of query
+int symfuzzy_register(sqlite3 *db);
+
+// symfst(query [, mode [, upper]]): prefix, range, regex or glob search over symbols.key
+int symfst_register(sqlite3 *db);
+
+// elf_symbols(path), elf_sections(path), elf_relocations(path): tables of a mapped elf, pdb or pe
+int elfvtab_register(sqlite3 *db);
@@ -0,0 +1,649 @@
+#include "SymbolExtension.h"
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// symfst: finite state transducer over symbols.key, mapping every key to its rowid
+//
+//   SELECT * FROM symfst('Actor::');                          -- prefix (default)
+//   SELECT * FROM symfst('Actor::', 'range', 'Actor;');       -- lo <= key < hi, hi may be NULL
+//   SELECT * FROM symfst('Actor::.*Tick', 'regex');           -- whole key must match
+//   SELECT * FROM symfst('Actor::*Tick', 'glob');
+//
+// the transducer is built once per connection from the rowid ordered keys (rowid order is key order),
+// queries walk it in key order while stepping an automaton, and stop descending as soon as it is dead.
+
+namespace {
+
+// keys repeat (one row per original), the output packs the first rowid and the number of extra rows
+constexpr int DupBits = 20;
+
+struct Fst {
+  struct Node {
+    uint32_t first, count;
+    uint64_t final_out;
+    bool final;
+  };
+  std::vector<Node> nodes;
+  std::vector<uint8_t> labels;
+  std::vector<uint64_t> outs;
+  std::vector<uint32_t> targets;
+  uint32_t root{};
+};
+
+// incremental construction of a minimal acyclic transducer from sorted input
+class FstBuilder {
+  struct Trans {
+    uint8_t label;
+    uint64_t out;
+    uint32_t target;
+  };
+  struct Unfinished {
+    std::vector<Trans> trans;
+    bool final         = false;
+    uint64_t final_out = 0;
+    bool has_last      = false;
+    uint8_t last_label = 0;
+    uint64_t last_out  = 0;
+  };
+
+  std::unique_ptr<Fst> fst = std::make_unique<Fst>();
+  std::vector<Unfinished> stack{1};
+  std::unordered_map<std::string, uint32_t> registry;
+  std::string prev, buf;
+  bool first = true;
+
+  uint32_t compile(Unfinished const &node) {
+    buf.assign((char const *) &node.final_out, sizeof node.final_out);
+    buf += (char) node.final;
+    for (auto &t : node.trans) {
+      buf += (char) t.label;
+      buf.append((char const *) &t.out, sizeof t.out);
+      buf.append((char const *) &t.target, sizeof t.target);
+    }
+    auto [it, inserted] = registry.try_emplace(buf, (uint32_t) fst->nodes.size());
+    if (!inserted) return it->second;
+    fst->nodes.push_back({(uint32_t) fst->labels.size(), (uint32_t) node.trans.size(), node.final_out, node.final});
+    for (auto &t : node.trans) {
+      fst->labels.push_back(t.label);
+      fst->outs.push_back(t.out);
+      fst->targets.push_back(t.target);
+    }
+    return it->second;
+  }
+
+  void freezeFrom(size_t depth) {
+    while (stack.size() > depth + 1) {
+      auto id = compile(stack.back());
+      stack.pop_back();
+      auto &parent = stack.back();
+      parent.trans.push_back({parent.last_label, parent.last_out, id});
+      parent.has_last = false;
+    }
+  }
+
+public:
+  // keys must be strictly increasing, values non decreasing
+  void Add(std::string_view key, uint64_t value) {
+    if (!first && key <= prev) throw std::runtime_error{"symbols must be sorted by key"};
+    first       = false;
+    auto common = (size_t) (std::mismatch(key.begin(), key.end(), prev.begin(), prev.end()).first - key.begin());
+    freezeFrom(common);
+    // push the shared part of the output towards the root
+    for (size_t i = 0; i < common; i++) {
+      auto &node = stack[i];
+      auto keep  = std::min(node.last_out, value);
+      auto rest  = node.last_out - keep;
+      node.last_out = keep;
+      value -= keep;
+      if (rest) {
+        auto &next = stack[i + 1];
+        for (auto &t : next.trans) t.out += rest;
+        if (next.final) next.final_out += rest;
+        if (next.has_last) next.last_out += rest;
+      }
+    }
+    if (key.size() == common) {
+      stack[common].final     = true;
+      stack[common].final_out = value;
+    } else {
+      for (size_t i = common; i < key.size(); i++) {
+        auto &node      = stack[i];
+        node.has_last   = true;
+        node.last_label = (uint8_t) key[i];
+        node.last_out   = i == common ? value : 0;
+        stack.emplace_back();
+      }
+      stack.back().final = true;
+    }
+    prev = key;
+  }
+
+  std::unique_ptr<Fst> Finish() {
+    freezeFrom(0);
+    fst->root = compile(stack[0]);
+    registry.clear();
+    return std::move(fst);
+  }
+};
+
+// automata return -1 for the dead state
+struct Automaton {
+  virtual ~Automaton() {}
+  virtual int Start()                       = 0;
+  virtual int Accept(int state, uint8_t ch) = 0;
+  virtual bool IsMatch(int state)           = 0;
+};
+
+struct PrefixAutomaton : Automaton {
+  std::string prefix;
+  PrefixAutomaton(std::string_view prefix) : prefix(prefix) {}
+  int Start() override { return 0; }
+  int Accept(int state, uint8_t ch) override {
+    if (state == (int) prefix.size()) return state;
+    return (uint8_t) prefix[state] == ch ? state + 1 : -1;
+  }
+  bool IsMatch(int state) override { return state == (int) prefix.size(); }
+};
+
+// lo <= key < hi, state is depth * 4 | equal to lo so far << 1 | equal to hi so far
+struct RangeAutomaton : Automaton {
+  std::string lo, hi;
+  bool bounded;
+  RangeAutomaton(std::string_view lo, std::string_view hi, bool bounded) : lo(lo), hi(hi), bounded(bounded) {}
+  int Start() override { return 2 | (bounded ? 1 : 0); }
+  int Accept(int state, uint8_t ch) override {
+    size_t depth = state >> 2;
+    bool onLo = state & 2, onHi = state & 1;
+    if (onLo && depth < lo.size()) {
+      if (ch < (uint8_t) lo[depth]) return -1;
+      onLo = ch == (uint8_t) lo[depth];
+    } else
+      onLo = false;
+    if (onHi) {
+      if (depth >= hi.size() || ch > (uint8_t) hi[depth]) return -1;
+      onHi = ch == (uint8_t) hi[depth];
+    }
+    return (int) (depth + 1) << 2 | onLo << 1 | onHi;
+  }
+  bool IsMatch(int state) override {
+    size_t depth = state >> 2;
+    if ((state & 2) && depth < lo.size()) return false;
+    if ((state & 1) && depth == hi.size()) return false;
+    return true;
+  }
+};
+
+// thompson nfa, simulated through a lazily built dfa
+class RegexAutomaton : public Automaton {
+  enum Type { Set, Split, Match };
+  struct State {
+    Type type;
+    std::bitset<256> set;
+    int out = -1, out1 = -1;
+  };
+  struct Frag {
+    int start;
+    std::vector<std::pair<int, int>> holes; // state, 0 for out or 1 for out1
+  };
+
+  std::vector<State> nfa;
+  std::string_view src;
+  size_t pos = 0;
+
+  std::map<std::vector<int>, int> ids;
+  std::vector<std::vector<int>> sets;
+  std::vector<std::array<int, 256>> next;
+  std::vector<bool> matches;
+
+  int add(State state) {
+    nfa.push_back(std::move(state));
+    return (int) nfa.size() - 1;
+  }
+
+  void patch(std::vector<std::pair<int, int>> const &holes, int target) {
+    for (auto [state, which] : holes) (which ? nfa[state].out1 : nfa[state].out) = target;
+  }
+
+  [[noreturn]] void error(char const *msg) {
+    throw std::runtime_error{std::string{msg} + " at " + std::to_string(pos) + " in regex"};
+  }
+
+  bool more() { return pos < src.size(); }
+
+  uint8_t escaped(std::bitset<256> &set) {
+    if (!more()) error("trailing backslash");
+    auto ch = (uint8_t) src[pos++];
+    auto range = [&](uint8_t a, uint8_t b) {
+      for (int c = a; c <= b; c++) set.set(c);
+    };
+    switch (ch) {
+    case 'd': range('0', '9'); return 0;
+    case 'w':
+      range('0', '9'), range('a', 'z'), range('A', 'Z'), set.set('_');
+      return 0;
+    case 's': set.set(' '), set.set('\t'), set.set('\n'), set.set('\r'); return 0;
+    default: set.set(ch); return ch;
+    }
+  }
+
+  Frag atom() {
+    State state{Set};
+    auto ch = (uint8_t) src[pos++];
+    switch (ch) {
+    case '(': {
+      auto frag = alternate();
+      if (!more() || src[pos] != ')') error("missing )");
+      pos++;
+      return frag;
+    }
+    case '.': state.set.set(); break;
+    case '\\': escaped(state.set); break;
+    case '[': {
+      bool negate = more() && src[pos] == '^';
+      if (negate) pos++;
+      bool firstChar = true;
+      while (more() && (src[pos] != ']' || firstChar)) {
+        firstChar = false;
+        uint8_t lo;
+        if (src[pos] == '\\') {
+          pos++;
+          lo = escaped(state.set);
+          if (!lo) continue;
+        } else
+          lo = (uint8_t) src[pos++];
+        if (pos + 1 < src.size() && src[pos] == '-' && src[pos + 1] != ']') {
+          auto hi = (uint8_t) src[pos + 1];
+          pos += 2;
+          for (int c = lo; c <= hi; c++) state.set.set(c);
+        } else
+          state.set.set(lo);
+      }
+      if (!more()) error("missing ]");
+      pos++;
+      if (negate) state.set.flip();
+    } break;
+    case '*':
+    case '+':
+    case '?':
+    case ')':
+    case '|': pos--; error("unexpected operator");
+    default: state.set.set(ch);
+    }
+    auto id = add(std::move(state));
+    return {id, {{id, 0}}};
+  }
+
+  Frag repeat() {
+    auto frag = atom();
+    while (more() && (src[pos] == '*' || src[pos] == '+' || src[pos] == '?')) {
+      auto op    = src[pos++];
+      auto split = add({Split, {}, frag.start});
+      if (op == '?') {
+        frag.holes.emplace_back(split, 1);
+        frag.start = split;
+      } else {
+        patch(frag.holes, split);
+        frag = {op == '*' ? split : frag.start, {{split, 1}}};
+      }
+    }
+    return frag;
+  }
+
+  Frag concat() {
+    if (!more() || src[pos] == '|' || src[pos] == ')') {
+      auto id = add({Split});
+      return {id, {{id, 0}}};
+    }
+    auto frag = repeat();
+    while (more() && src[pos] != '|' && src[pos] != ')') {
+      auto next = repeat();
+      patch(frag.holes, next.start);
+      frag.holes = std::move(next.holes);
+    }
+    return frag;
+  }
+
+  Frag alternate() {
+    auto frag = concat();
+    while (more() && src[pos] == '|') {
+      pos++;
+      auto other = concat();
+      auto split = add({Split, {}, frag.start, other.start});
+      frag.start = split;
+      frag.holes.insert(frag.holes.end(), other.holes.begin(), other.holes.end());
+    }
+    return frag;
+  }
+
+  void closure(int state, std::vector<int> &set, std::vector<bool> &seen) {
+    if (state < 0 || seen[state]) return;
+    seen[state] = true;
+    if (nfa[state].type == Split) {
+      closure(nfa[state].out, set, seen);
+      closure(nfa[state].out1, set, seen);
+    } else
+      set.push_back(state);
+  }
+
+  int intern(std::vector<int> set) {
+    if (set.empty()) return -1;
+    std::sort(set.begin(), set.end());
+    auto [it, inserted] = ids.try_emplace(set, (int) sets.size());
+    if (inserted) {
+      if (sets.size() >= 10000) throw std::runtime_error{"regex is too complex"};
+      matches.push_back(std::any_of(set.begin(), set.end(), [&](int s) { return nfa[s].type == Match; }));
+      sets.push_back(std::move(set));
+      next.emplace_back().fill(-2);
+    }
+    return it->second;
+  }
+
+  int start;
+
+public:
+  RegexAutomaton(std::string_view pattern) : src(pattern) {
+    auto frag = alternate();
+    if (more()) error("unexpected )");
+    patch(frag.holes, add({Match}));
+    std::vector<int> set;
+    std::vector<bool> seen(nfa.size());
+    closure(frag.start, set, seen);
+    start = intern(std::move(set));
+  }
+
+  int Start() override { return start; }
+
+  int Accept(int state, uint8_t ch) override {
+    auto &slot = next[state][ch];
+    if (slot != -2) return slot;
+    std::vector<int> set;
+    std::vector<bool> seen(nfa.size());
+    for (auto s : sets[state])
+      if (nfa[s].type == Set && nfa[s].set.test(ch)) closure(nfa[s].out, set, seen);
+    auto id = intern(std::move(set));
+    return next[state][ch] = id;
+  }
+
+  bool IsMatch(int state) override { return matches[state]; }
+};
+
+std::string globToRegex(std::string_view glob) {
+  std::string regex;
+  for (size_t i = 0; i < glob.size(); i++) {
+    auto ch = glob[i];
+    if (ch == '*')
+      regex += ".*";
+    else if (ch == '?')
+      regex += '.';
+    else if (ch == '[') {
+      // [!...] is the negated class of glob, a ] right after the opener is a member
+      auto negate = i + 1 < glob.size() && glob[i + 1] == '!';
+      auto first  = i + (negate ? 2 : 1);
+      auto end    = glob.find(']', first + 1);
+      if (end == std::string_view::npos) {
+        regex += "\\[";
+        continue;
+      }
+      regex += negate ? "[^" : "[";
+      regex.append(glob.substr(first, end - first + 1));
+      i = end;
+    } else {
+      if (std::string_view{"\\.+()|{}^$"}.find(ch) != std::string_view::npos) regex += '\\';
+      regex += ch;
+    }
+  }
+  return regex;
+}
+
+enum Column { COL_KEY, COL_ID, COL_QUERY, COL_MODE, COL_UPPER };
+
+struct FstTable : sqlite3_vtab {
+  sqlite3 *db;
+  std::unique_ptr<Fst> fst;
+};
+
+struct FstCursor : sqlite3_vtab_cursor {
+  struct Frame {
+    uint32_t node, next;
+    int state;
+    uint64_t out;
+  };
+  Fst const *fst{};
+  std::unique_ptr<Automaton> automaton;
+  std::vector<Frame> stack;
+  std::string key;
+  sqlite3_int64 rowid{}, last{};
+  bool eof = true;
+
+  bool match(uint32_t node, int state, uint64_t out) {
+    auto &n = fst->nodes[node];
+    if (!n.final || !automaton->IsMatch(state)) return false;
+    auto value = out + n.final_out;
+    rowid      = (sqlite3_int64) (value >> DupBits);
+    last       = rowid + (sqlite3_int64) (value & ((1 << DupBits) - 1));
+    return true;
+  }
+
+  void advance() {
+    if (!eof && rowid < last) {
+      rowid++;
+      return;
+    }
+    while (!stack.empty()) {
+      auto &frame = stack.back();
+      auto &node  = fst->nodes[frame.node];
+      if (frame.next == node.count) {
+        stack.pop_back();
+        if (!key.empty()) key.pop_back();
+        continue;
+      }
+      auto t     = node.first + frame.next++;
+      auto state = automaton->Accept(frame.state, fst->labels[t]);
+      if (state < 0) continue;
+      auto out = frame.out + fst->outs[t];
+      key += (char) fst->labels[t];
+      stack.push_back({fst->targets[t], 0, state, out});
+      if (match(fst->targets[t], state, out)) {
+        eof = false;
+        return;
+      }
+    }
+    eof = true;
+  }
+};
+
+int loadFst(FstTable *table) {
+  if (table->fst) return SQLITE_OK;
+  sqlite3_stmt *stmt = nullptr;
+  int rc = sqlite3_prepare_v2(table->db, "SELECT rowid, key FROM symbols ORDER BY rowid;", -1, &stmt, nullptr);
+  try {
+    FstBuilder builder;
+    std::string key;
+    sqlite3_int64 first = 0, count = 0;
+    auto flush = [&] {
+      if (count) builder.Add(key, (uint64_t) first << DupBits | (uint64_t) (count - 1));
+    };
+    while (rc == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+      std::string_view current{(char const *) sqlite3_column_text(stmt, 1), (size_t) sqlite3_column_bytes(stmt, 1)};
+      auto id = sqlite3_column_int64(stmt, 0);
+      if (count && current == key && id == first + count && count < (1 << DupBits)) {
+        count++;
+        continue;
+      }
+      flush();
+      key   = current;
+      first = id;
+      count = 1;
+    }
+    flush();
+    if (rc == SQLITE_OK) rc = sqlite3_finalize(stmt);
+    stmt = nullptr;
+    if (rc == SQLITE_OK) table->fst = builder.Finish();
+  } catch (std::exception const &e) {
+    sqlite3_finalize(stmt);
+    sqlite3_free(table->zErrMsg);
+    table->zErrMsg = sqlite3_mprintf("%s", e.what());
+    return SQLITE_ERROR;
+  }
+  if (rc != SQLITE_OK) {
+    sqlite3_free(table->zErrMsg);
+    table->zErrMsg = sqlite3_mprintf("%s", sqlite3_errmsg(table->db));
+  }
+  return rc;
+}
+
+int fstConnect(sqlite3 *db, void *, int, const char *const *, sqlite3_vtab **ppVtab, char **) {
+  int rc = sqlite3_declare_vtab(db, "CREATE TABLE x(key TEXT, id INT, query HIDDEN, mode HIDDEN, upper HIDDEN)");
+  if (rc != SQLITE_OK) return rc;
+  auto table = new FstTable{};
+  table->db  = db;
+  *ppVtab    = table;
+  return SQLITE_OK;
+}
+
+int fstDisconnect(sqlite3_vtab *pVtab) {
+  delete (FstTable *) pVtab;
+  return SQLITE_OK;
+}
+
+// idxNum: bit n set when the hidden column COL_QUERY + n is given, passed to xFilter in that order
+int fstBestIndex(sqlite3_vtab *, sqlite3_index_info *info) {
+  int used[3] = {-1, -1, -1};
+  for (int i = 0; i < info->nConstraint; i++) {
+    auto &c = info->aConstraint[i];
+    if (c.op != SQLITE_INDEX_CONSTRAINT_EQ || c.iColumn < COL_QUERY) continue;
+    if (!c.usable) return SQLITE_CONSTRAINT;
+    used[c.iColumn - COL_QUERY] = i;
+  }
+  if (used[0] < 0) return SQLITE_CONSTRAINT;
+  int argc = 0;
+  for (int i = 0; i < 3; i++) {
+    if (used[i] < 0) continue;
+    info->aConstraintUsage[used[i]].argvIndex = ++argc;
+    info->aConstraintUsage[used[i]].omit      = 1;
+    info->idxNum |= 1 << i;
+  }
+  // results come out in key order, which is rowid order
+  if (info->nOrderBy == 1 && !info->aOrderBy[0].desc &&
+      (info->aOrderBy[0].iColumn == COL_KEY || info->aOrderBy[0].iColumn == COL_ID))
+    info->orderByConsumed = 1;
+  info->estimatedCost = 100;
+  return SQLITE_OK;
+}
+
+int fstOpen(sqlite3_vtab *, sqlite3_vtab_cursor **ppCursor) {
+  *ppCursor = new FstCursor{};
+  return SQLITE_OK;
+}
+
+int fstClose(sqlite3_vtab_cursor *cur) {
+  delete (FstCursor *) cur;
+  return SQLITE_OK;
+}
+
+int fstFilter(sqlite3_vtab_cursor *pCursor, int idxNum, const char *, int argc, sqlite3_value **argv) {
+  auto cursor = (FstCursor *) pCursor;
+  auto table  = (FstTable *) pCursor->pVtab;
+  cursor->stack.clear();
+  cursor->key.clear();
+  cursor->eof = true;
+  if (int rc = loadFst(table); rc != SQLITE_OK) return rc;
+
+  sqlite3_value *args[3]{};
+  for (int i = 0, n = 0; i < 3; i++)
+    if (idxNum & (1 << i)) args[i] = argv[n++];
+  auto text = [](sqlite3_value *value) {
+    return std::string_view{(char const *) sqlite3_value_text(value), (size_t) sqlite3_value_bytes(value)};
+  };
+  if (sqlite3_value_type(args[0]) == SQLITE_NULL) return SQLITE_OK;
+  auto query = text(args[0]);
+  auto mode  = args[1] ? text(args[1]) : "prefix";
+
+  try {
+    if (mode == "prefix")
+      cursor->automaton = std::make_unique<PrefixAutomaton>(query);
+    else if (mode == "range") {
+      bool bounded = args[2] && sqlite3_value_type(args[2]) != SQLITE_NULL;
+      cursor->automaton =
+          std::make_unique<RangeAutomaton>(query, bounded ? text(args[2]) : std::string_view{}, bounded);
+    } else if (mode == "regex")
+      cursor->automaton = std::make_unique<RegexAutomaton>(query);
+    else if (mode == "glob")
+      cursor->automaton = std::make_unique<RegexAutomaton>(globToRegex(query));
+    else
+      throw std::runtime_error{"unknown symfst mode, expect prefix, range, regex or glob"};
+
+    // stepping the automaton builds dfa states, which throws on too complex patterns
+    cursor->fst = table->fst.get();
+    auto start  = cursor->automaton->Start();
+    if (start < 0) return SQLITE_OK;
+    cursor->stack.push_back({cursor->fst->root, 0, start, 0});
+    if (cursor->match(cursor->fst->root, start, 0))
+      cursor->eof = false;
+    else
+      cursor->advance();
+  } catch (std::exception const &e) {
+    cursor->stack.clear();
+    cursor->eof = true;
+    sqlite3_free(table->zErrMsg);
+    table->zErrMsg = sqlite3_mprintf("%s", e.what());
+    return SQLITE_ERROR;
+  }
+  return SQLITE_OK;
+}
+
+int fstNext(sqlite3_vtab_cursor *pCursor) {
+  try {
+    ((FstCursor *) pCursor)->advance();
+  } catch (std::exception const &e) {
+    sqlite3_free(pCursor->pVtab->zErrMsg);
+    pCursor->pVtab->zErrMsg = sqlite3_mprintf("%s", e.what());
+    return SQLITE_ERROR;
+  }
+  return SQLITE_OK;
+}
+
+int fstEof(sqlite3_vtab_cursor *pCursor) { return ((FstCursor *) pCursor)->eof; }
+
+int fstColumn(sqlite3_vtab_cursor *pCursor, sqlite3_context *ctx, int col) {
+  auto cursor = (FstCursor *) pCursor;
+  switch (col) {
+  case COL_KEY: sqlite3_result_text(ctx, cursor->key.c_str(), (int) cursor->key.size(), SQLITE_TRANSIENT); break;
+  case COL_ID: sqlite3_result_int64(ctx, cursor->rowid); break;
+  default: sqlite3_result_null(ctx); break;
+  }
+  return SQLITE_OK;
+}
+
+int fstRowid(sqlite3_vtab_cursor *pCursor, sqlite3_int64 *pRowid) {
+  *pRowid = ((FstCursor *) pCursor)->rowid;
+  return SQLITE_OK;
+}
+
+sqlite3_module fstModule{
+    .iVersion    = 0,
+    .xCreate     = nullptr,
+    .xConnect    = fstConnect,
+    .xBestIndex  = fstBestIndex,
+    .xDisconnect = fstDisconnect,
+    .xDestroy    = fstDisconnect,
+    .xOpen       = fstOpen,
+    .xClose      = fstClose,
+    .xFilter     = fstFilter,
+    .xNext       = fstNext,
+    .xEof        = fstEof,
+    .xColumn     = fstColumn,
+    .xRowid      = fstRowid,
+};
+
+} // namespace
+
+int symfst_register(sqlite3 *db) { return sqlite3_create_module(db, "symfst", &fstModule, nullptr); }
@@ -0,0 +1,217 @@
+#include "SymbolExtension.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+
+// symfuzzy: typo tolerant lookup over the vocabulary of fts_symbols
+//
+//   SELECT term, distance FROM symfuzzy('getDimention');
+//   SELECT term, distance FROM symfuzzy('ActorFactorey', 2);
+//
+// the sorted term list is read once per connection from fts_symbols_vocab, which walks the whole fts index,
+// so the first lookup on a connection is slow until a "SELECT count(*) FROM symfuzzy('')" has warmed it up.
+// terms are walked in order while one levenshtein row per character is kept, so terms sharing a prefix
+// reuse its rows, and once every cell of a row exceeds max the whole prefix range is skipped.
+
+namespace {
+
+enum Column { COL_TERM, COL_DISTANCE, COL_QUERY, COL_MAX };
+
+struct FuzzyTable : sqlite3_vtab {
+  sqlite3 *db;
+  bool loaded = false;
+  std::vector<std::string> terms;
+};
+
+struct FuzzyCursor : sqlite3_vtab_cursor {
+  std::vector<std::pair<std::string const *, int>> results;
+  size_t index = 0;
+};
+
+inline char fold(char ch) { return 'A' <= ch && ch <= 'Z' ? ch - 'A' + 'a' : ch; }
+
+int load(FuzzyTable *table) {
+  if (table->loaded) return SQLITE_OK;
+  sqlite3_stmt *stmt = nullptr;
+  // one letter terms are camel case pieces like the "U" of "UUID", every query is within a typo of them
+  int rc = sqlite3_prepare_v2(
+      table->db, "SELECT term FROM fts_symbols_vocab WHERE length(term) > 1 ORDER BY term;", -1, &stmt, nullptr);
+  while (rc == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+    table->terms.emplace_back(
+        (char const *) sqlite3_column_text(stmt, 0), (size_t) sqlite3_column_bytes(stmt, 0));
+  if (rc == SQLITE_OK) rc = sqlite3_finalize(stmt);
+  if (rc != SQLITE_OK) {
+    sqlite3_free(table->zErrMsg);
+    table->zErrMsg = sqlite3_mprintf("%s", sqlite3_errmsg(table->db));
+    table->terms.clear();
+    return rc;
+  }
+  table->loaded = true;
+  return SQLITE_OK;
+}
+
+void search(
+    std::vector<std::string> const &terms, std::string_view query, int max,
+    std::vector<std::pair<std::string const *, int>> &results) {
+  auto width = query.size() + 1;
+  // rows[d] is the levenshtein row of the first d characters of the current term
+  std::vector<int> rows(width);
+  for (size_t j = 0; j < width; j++) rows[j] = (int) j;
+
+  std::string_view prev;
+  size_t valid = 0; // number of rows after rows[0] computed for prev
+  for (size_t i = 0; i < terms.size();) {
+    std::string_view term = terms[i];
+    size_t depth          = 0;
+    while (depth < valid && depth < term.size() && term[depth] == prev[depth]) depth++;
+    if (rows.size() < (term.size() + 1) * width) rows.resize((term.size() + 1) * width);
+
+    bool pruned = false;
+    for (; depth < term.size(); depth++) {
+      auto last = &rows[depth * width];
+      auto cur  = last + width;
+      cur[0]    = (int) depth + 1;
+      int low   = cur[0];
+      for (size_t j = 1; j < width; j++) {
+        int cost = fold(term[depth]) == fold(query[j - 1]) ? 0 : 1;
+        cur[j]   = std::min({last[j] + 1, cur[j - 1] + 1, last[j - 1] + cost});
+        low      = std::min(low, cur[j]);
+      }
+      if (low > max) {
+        pruned = true;
+        depth++;
+        break;
+      }
+    }
+    prev  = term;
+    valid = depth;
+
+    if (pruned) {
+      // every term starting with this prefix is out of reach
+      auto prefix = term.substr(0, depth);
+      i = std::partition_point(terms.begin() + i, terms.end(), [&](std::string const &t) {
+            return t.starts_with(prefix);
+          }) -
+          terms.begin();
+      continue;
+    }
+    if (auto distance = rows[term.size() * width + query.size()]; distance <= max)
+      results.emplace_back(&terms[i], distance);
+    i++;
+  }
+}
+
+int fuzzyConnect(sqlite3 *db, void *, int, const char *const *, sqlite3_vtab **ppVtab, char **) {
+  int rc = sqlite3_declare_vtab(db, "CREATE TABLE x(term TEXT, distance INT, query HIDDEN, max HIDDEN)");
+  if (rc != SQLITE_OK) return rc;
+  auto table = new FuzzyTable{};
+  table->db  = db;
+  *ppVtab    = table;
+  return SQLITE_OK;
+}
+
+int fuzzyDisconnect(sqlite3_vtab *pVtab) {
+  delete (FuzzyTable *) pVtab;
+  return SQLITE_OK;
+}
+
+// idxNum: bit 0 - query is given, bit 1 - max is given
+int fuzzyBestIndex(sqlite3_vtab *, sqlite3_index_info *info) {
+  int query = -1, max = -1;
+  for (int i = 0; i < info->nConstraint; i++) {
+    auto &c = info->aConstraint[i];
+    if (c.op != SQLITE_INDEX_CONSTRAINT_EQ) continue;
+    if (c.iColumn == COL_QUERY) {
+      if (!c.usable) return SQLITE_CONSTRAINT;
+      query = i;
+    } else if (c.iColumn == COL_MAX && c.usable)
+      max = i;
+  }
+  if (query < 0) return SQLITE_CONSTRAINT;
+  info->aConstraintUsage[query].argvIndex = 1;
+  info->aConstraintUsage[query].omit      = 1;
+  info->idxNum                            = 1;
+  if (max >= 0) {
+    info->aConstraintUsage[max].argvIndex = 2;
+    info->aConstraintUsage[max].omit      = 1;
+    info->idxNum |= 2;
+  }
+  info->estimatedCost = 1000;
+  info->estimatedRows = 32;
+  return SQLITE_OK;
+}
+
+int fuzzyOpen(sqlite3_vtab *, sqlite3_vtab_cursor **ppCursor) {
+  *ppCursor = new FuzzyCursor{};
+  return SQLITE_OK;
+}
+
+int fuzzyClose(sqlite3_vtab_cursor *cur) {
+  delete (FuzzyCursor *) cur;
+  return SQLITE_OK;
+}
+
+int fuzzyFilter(sqlite3_vtab_cursor *pCursor, int idxNum, const char *, int argc, sqlite3_value **argv) {
+  auto cursor = (FuzzyCursor *) pCursor;
+  auto table  = (FuzzyTable *) pCursor->pVtab;
+  cursor->results.clear();
+  cursor->index = 0;
+  if (int rc = load(table); rc != SQLITE_OK) return rc;
+  if (argc < 1 || sqlite3_value_type(argv[0]) == SQLITE_NULL) return SQLITE_OK;
+
+  std::string_view query{(char const *) sqlite3_value_text(argv[0]), (size_t) sqlite3_value_bytes(argv[0])};
+  // short words tolerate fewer typos by default, a negative max would match nothing and means exact matches
+  int max = (idxNum & 2) ? std::max(sqlite3_value_int(argv[1]), 0) : query.size() <= 4 ? 1 : 2;
+  search(table->terms, query, max, cursor->results);
+  std::stable_sort(cursor->results.begin(), cursor->results.end(), [](auto const &a, auto const &b) {
+    return a.second < b.second;
+  });
+  return SQLITE_OK;
+}
+
+int fuzzyNext(sqlite3_vtab_cursor *pCursor) {
+  ((FuzzyCursor *) pCursor)->index++;
+  return SQLITE_OK;
+}
+
+int fuzzyEof(sqlite3_vtab_cursor *pCursor) {
+  auto cursor = (FuzzyCursor *) pCursor;
+  return cursor->index >= cursor->results.size();
+}
+
+int fuzzyColumn(sqlite3_vtab_cursor *pCursor, sqlite3_context *ctx, int col) {
+  auto cursor           = (FuzzyCursor *) pCursor;
+  auto &[term, distance] = cursor->results[cursor->index];
+  switch (col) {
+  case COL_TERM: sqlite3_result_text(ctx, term->c_str(), (int) term->size(), SQLITE_STATIC); break;
+  case COL_DISTANCE: sqlite3_result_int(ctx, distance); break;
+  default: sqlite3_result_null(ctx); break;
+  }
+  return SQLITE_OK;
+}
+
+int fuzzyRowid(sqlite3_vtab_cursor *pCursor, sqlite3_int64 *pRowid) {
+  *pRowid = (sqlite3_int64) ((FuzzyCursor *) pCursor)->index;
+  return SQLITE_OK;
+}
+
+sqlite3_module fuzzyModule{
+    .iVersion    = 0,
+    .xCreate     = nullptr,
+    .xConnect    = fuzzyConnect,
+    .xBestIndex  = fuzzyBestIndex,
+    .xDisconnect = fuzzyDisconnect,
+    .xDestroy    = fuzzyDisconnect,
+    .xOpen       = fuzzyOpen,
+    .xClose      = fuzzyClose,
+    .xFilter     = fuzzyFilter,
+    .xNext       = fuzzyNext,
+    .xEof        = fuzzyEof,
+    .xColumn     = fuzzyColumn,
+    .xRowid      = fuzzyRowid,
+};
+
+} // namespace
+
+int symfuzzy_register(sqlite3 *db) { return sqlite3_create_module(db, "symfuzzy", &fuzzyModule, nullptr); }
@@ -1,6 +1,11 @@
-#include "sqlite3ext.h"
+#include "SymbolExtension.h"
 #include <string_view>
 #include <iostream>
+#include <string>
+#include <vector>
+#include <queue>
+#include <functional>
+#include <algorithm>
 
 SQLITE_EXTENSION_INIT1
 
@@ -18,11 +23,32 @@ static fts5_api *fts5_api_from_db(sqlite3 *db) {
 
 static fts5_api *fts5 = nullptr;
 
+// tokenize='symbol [initials] [fold]'
+//   initials: also index "PAM" for "PlayerActionManager" and "gL" for "getLevel",
+//             a query written like initials is looked up as that one token
+//   fold:     also index the lower case form of every token
+struct SymbolTokenizer {
+  bool initials = false;
+  bool fold     = false;
+};
+
 static int symbol_xCreate(void *, const char **azArg, int nArg, Fts5Tokenizer **ppOut) {
-  *ppOut = (Fts5Tokenizer *) "fake";
+  auto ret = new SymbolTokenizer;
+  for (int i = 0; i < nArg; i++) {
+    std::string_view arg{azArg[i]};
+    if (arg == "initials")
+      ret->initials = true;
+    else if (arg == "fold")
+      ret->fold = true;
+    else {
+      delete ret;
+      return SQLITE_ERROR;
+    }
+  }
+  *ppOut = (Fts5Tokenizer *) ret;
   return SQLITE_OK;
 }
-static void symbol_xDelete(Fts5Tokenizer *self) {}
+static void symbol_xDelete(Fts5Tokenizer *self) { delete (SymbolTokenizer *) self; }
 
 inline bool isTokenChar(char ch) { return ch == '$' || ch == '_' || 'a' <= ch && ch <= 'z' || 'A' <= ch && ch <= 'Z'; }
 
@@ -34,6 +60,28 @@ inline bool isNum(char ch) { return '0' <= ch && ch <= '9'; }
 
 inline bool isSep(char ch) { return !isTokenChar(ch) && !isNum(ch); }
 
+inline char toLowerCase(char ch) { return isUpperCase(ch) ? ch - 'A' + 'a' : ch; }
+
+// first letter of every camel case or snake case piece, empty when the token is a single piece
+static std::string initialsOf(const char *token, int len) {
+  std::string ret;
+  for (int i = 0; i < len; i++) {
+    auto cur   = token[i];
+    auto prev  = i > 0 ? token[i - 1] : '_';
+    bool start = isAlpha(cur) && (prev == '_' || prev == '$' || isNum(prev) || isUpperCase(cur) && !isUpperCase(prev));
+    if (start) ret += cur;
+  }
+  if (ret.size() < 2) ret.clear();
+  return ret;
+}
+
+// length of the identifier at text when every camel case piece of it is a single letter, like "PAM" or "gL", else 0
+static int initialsAt(const char *text, int len) {
+  int n = 0;
+  while (n < len && isAlpha(text[n]) && !(n > 0 && !isUpperCase(text[n]) && !isUpperCase(text[n - 1]))) n++;
+  return n < len && !isSep(text[n]) ? 0 : n;
+}
+
 #if 1 && !defined(NDEBUG)
 #  define iemit oemit
 #  define DEBUG_EMIT
@@ -42,7 +90,7 @@ inline bool isSep(char ch) { return !isTokenChar(ch) && !isNum(ch); }
 #endif
 
 static int symbol_tokenize(
-    Fts5Tokenizer *, void *ctx, int flags, const char *text, int len,
+    Fts5Tokenizer *self, void *ctx, int flags, const char *text, int len,
     int (*iemit)(void *pCtx, int tflags, const char *pToken, int nToken, int iStart, int iEnd)) {
   int rc = SQLITE_OK;
   if (text == NULL) return rc;
@@ -57,11 +105,45 @@ static int symbol_tokenize(
   };
 #endif
 
+  // synonyms are only indexed, queries are matched against them as they are
+  auto const &options = *(SymbolTokenizer *) self;
+  bool synonyms       = (options.initials || options.fold) && !(flags & FTS5_TOKENIZE_QUERY);
+  bool lookupInitials = options.initials && (flags & FTS5_TOKENIZE_QUERY);
+  std::string buf;
+  auto put = [&](const char *token, int n, int iStart, int iEnd) {
+    emit(ctx, 0, token, n, iStart, iEnd);
+    if (!synonyms) return;
+    if (options.fold) {
+      buf.assign(token, n);
+      for (auto &ch : buf) ch = toLowerCase(ch);
+      if (buf.compare(0, n, token, n) != 0) emit(ctx, FTS5_TOKEN_COLOCATED, buf.data(), n, iStart, iEnd);
+    }
+    if (options.initials) {
+      buf = initialsOf(token, n);
+      if (buf.empty()) return;
+      emit(ctx, FTS5_TOKEN_COLOCATED, buf.data(), (int) buf.size(), iStart, iEnd);
+      if (options.fold) {
+        for (auto &ch : buf) ch = toLowerCase(ch);
+        emit(ctx, FTS5_TOKEN_COLOCATED, buf.data(), (int) buf.size(), iStart, iEnd);
+      }
+    }
+  };
+
   for (int i = 0; i < len; i++) {
     auto const &cur = text[i];
     switch (state) {
     case State::None:
       rec0 = rec1 = i;
+      // initials are only indexed on the whole identifier, so "PAM" is not split into "P", "A", "M" to find them
+      if (int n; lookupInitials && (n = initialsAt(text + i, len - i)) >= 2) {
+        put(text + i, n, i, i + n);
+        i += n;
+        if (i < len && text[i] == ':') {
+          state = State::Seprator;
+          rec0  = i;
+        }
+        continue;
+      }
       if (isTokenChar(cur))
         state = State::Alpha;
       else if (isNum(cur))
@@ -70,42 +152,42 @@ static int symbol_tokenize(
     case State::Alpha:
       if (isSep(cur)) {
         state = cur == ':' ? State::Seprator : State::None;
-        emit(ctx, 0, text + rec0, i - rec0, rec0, i);
+        put(text + rec0, i - rec0, rec0, i);
         if (rec0 != rec1)
-          emit(ctx, 0, text + rec1, i - rec1, rec1, i);
+          put(text + rec1, i - rec1, rec1, i);
         else if (std::string_view{text + rec0, (size_t) i - rec0} == "operator") {
           rec1  = i;
           state = State::Operator;
         }
         rec0 = i;
       } else if (isUpperCase(cur) || isNum(cur)) {
-        emit(ctx, 0, text + rec1, i - rec1, rec1, i);
+        put(text + rec1, i - rec1, rec1, i);
         rec1 = i;
       } else if (cur == '_' && text[rec0] != '$') {
-        emit(ctx, 0, text + rec1, i - rec1, rec1, i);
+        put(text + rec1, i - rec1, rec1, i);
         rec1 = ++i;
       }
       break;
     case State::Number:
       if (isNum(cur)) continue;
       if (isTokenChar(cur)) {
-        emit(ctx, 0, text + rec1, i - rec1, rec1, i);
+        put(text + rec1, i - rec1, rec1, i);
         rec1  = i;
         state = State::Alpha;
       } else if (isSep(cur)) {
-        emit(ctx, 0, text + rec0, i - rec0, rec0, i);
-        if (rec0 != rec1) emit(ctx, 0, text + rec1, i - rec1, rec1, i);
+        put(text + rec0, i - rec0, rec0, i);
+        if (rec0 != rec1) put(text + rec1, i - rec1, rec1, i);
         state = cur == ':' ? State::Seprator : State::None;
         rec0  = i;
       }
       break;
     case State::Seprator:
-      if (cur == ':') emit(ctx, 0, text + rec0, i - rec0 + 1, rec0, i + 1);
+      if (cur == ':') put(text + rec0, i - rec0 + 1, rec0, i + 1);
       state = State::None;
       break;
     case State::Operator:
       if (cur == '(') {
-        emit(ctx, 0, text + rec0, i - rec0, rec0, i);
+        put(text + rec0, i - rec0, rec0, i);
         state = State::None;
       }
       break;
@@ -116,10 +198,10 @@ static int symbol_tokenize(
   case State::None: break;
   case State::Alpha:
   case State::Number:
-    emit(ctx, 0, text + rec0, len - rec0, rec0, len);
-    if (rec0 != rec1) emit(ctx, 0, text + rec1, len - rec1, rec1, len);
+    put(text + rec0, len - rec0, rec0, len);
+    if (rec0 != rec1) put(text + rec1, len - rec1, rec1, len);
     break;
-  case State::Operator: emit(ctx, 0, text + rec0, len - rec0, rec0, len); break;
+  case State::Operator: put(text + rec0, len - rec0, rec0, len); break;
   default: break;
   }
   return rc;
@@ -131,6 +213,215 @@ static fts5_tokenizer tokenizer{
     .xTokenize = symbol_tokenize,
 };
 
+using emit_fn = int (*)(void *pCtx, int tflags, const char *pToken, int nToken, int iStart, int iEnd);
+
+inline bool isIdentChar(char ch) { return isTokenChar(ch) || isNum(ch); }
+
+// emits an identifier embedded in a mangled name,
+// when indexing its camel case pieces are added as colocated tokens, so "PEAVActor" can be found by "Actor"
+static int mangled_emit(void *ctx, int flags, const char *text, int start, int end, emit_fn emit) {
+  if (end - start < 2) return SQLITE_OK;
+  int rc = emit(ctx, 0, text + start, end - start, start, end);
+  if (rc != SQLITE_OK || (flags & FTS5_TOKENIZE_QUERY)) return rc;
+  int piece = start;
+  for (int i = start + 1; i <= end && rc == SQLITE_OK; i++) {
+    bool boundary = i == end || text[i] == '_' ||
+                    isUpperCase(text[i]) && (!isUpperCase(text[i - 1]) || i + 1 < end && isAlpha(text[i + 1]) &&
+                                                                             !isUpperCase(text[i + 1]));
+    if (!boundary) continue;
+    if (i - piece >= 2 && !(piece == start && i == end))
+      rc = emit(ctx, FTS5_TOKEN_COLOCATED, text + piece, i - piece, piece, i);
+    piece = text[i] == '_' ? i + 1 : i;
+  }
+  return rc;
+}
+
+// itanium: source names are length prefixed, "_ZN5Actor4tickEv" gives "Actor" and "tick",
+// "_ZN4UUIDC2Ev" gives only "UUID" while "_ZN4UUID8asStringEv" gives "UUID" and "asString"
+static int mangled_itanium(void *ctx, int flags, const char *text, int len, int from, emit_fn emit) {
+  int rc = SQLITE_OK;
+  // end of the last emitted source name, the letters before it belong to that name and are no mangling codes
+  int named = from;
+  for (int i = from; i < len && rc == SQLITE_OK;) {
+    if (!isNum(text[i])) {
+      i++;
+      continue;
+    }
+    int j = i, n = 0;
+    while (j < len && isNum(text[j]) && n < len) n = n * 10 + (text[j++] - '0');
+    // C1-C5/D0-D5 are constructors/destructors, L<type><number>E are literals
+    bool special = i - 1 >= named && (text[i - 1] == 'C' || text[i - 1] == 'D') && j - i == 1 ||
+                   i - 2 >= named && text[i - 2] == 'L';
+    bool valid   = !special && n > 0 && j + n <= len;
+    bool alpha   = false;
+    for (int k = j; valid && k < j + n; k++) {
+      valid = isIdentChar(text[k]);
+      alpha = alpha || isAlpha(text[k]);
+    }
+    if (valid && alpha) {
+      rc    = mangled_emit(ctx, flags, text, j, j + n, emit);
+      i     = j + n;
+      named = i;
+    } else
+      i = j;
+  }
+  return rc;
+}
+
+// msvc: name fragments are terminated by '@', "?tick@Level@@QEAAXXZ" gives "tick" and "Level"
+static int mangled_msvc(void *ctx, int flags, const char *text, int len, emit_fn emit) {
+  int rc = SQLITE_OK;
+  for (int i = 0; i < len && rc == SQLITE_OK;) {
+    if (!isIdentChar(text[i])) {
+      i++;
+      continue;
+    }
+    int j = i;
+    while (j < len && isIdentChar(text[j])) j++;
+    if (j < len && text[j] == '@') {
+      int start = i;
+      if (text[start] == '$') // ?$name: template name
+        start++;
+      else if (i >= 2 && text[i - 1] == '?' && text[i - 2] == '?') // ??0, ??_7...: special name code
+        start += text[start] == '_' ? 2 : 1;
+      // identifiers never start with a digit, those are back references or vtable qualifiers
+      if (start < j && !isNum(text[start])) rc = mangled_emit(ctx, flags, text, start, j, emit);
+    }
+    i = j;
+  }
+  return rc;
+}
+
+static int mangled_tokenize(Fts5Tokenizer *, void *ctx, int flags, const char *text, int len, emit_fn emit) {
+  if (text == NULL) return SQLITE_OK;
+  std::string_view view{text, (size_t) len};
+  if (view.starts_with("_Z")) return mangled_itanium(ctx, flags, text, len, 2, emit);
+  if (view.starts_with("__Z")) return mangled_itanium(ctx, flags, text, len, 3, emit);
+  if (view.starts_with("?")) return mangled_msvc(ctx, flags, text, len, emit);
+  // plain c names
+  int rc = SQLITE_OK;
+  for (int i = 0; i < len && rc == SQLITE_OK;) {
+    int j = i;
+    while (j < len && isIdentChar(text[j])) j++;
+    if (j > i) rc = mangled_emit(ctx, flags, text, i, j, emit);
+    i = j + 1;
+  }
+  return rc;
+}
+
+static fts5_tokenizer mangled_tokenizer{
+    .xCreate   = symbol_xCreate,
+    .xDelete   = symbol_xDelete,
+    .xTokenize = mangled_tokenize,
+};
+
+// bounds of the name part of a printed symbol, "A::B<C>::f(int) -> void" gives "A::B<C>::f" and its last segment "f"
+static void symname(const char *text, int len, int &last_start, int &name_end) {
+  int level = 0;
+  last_start = 0;
+  name_end   = len;
+  for (int i = 0; i < len; i++) {
+    auto cur = text[i];
+    if (cur == '<')
+      level++;
+    else if (cur == '>' && level > 0)
+      level--;
+    else if (level == 0) {
+      if (cur == '(' || cur == ' ') {
+        name_end = i;
+        break;
+      }
+      if (cur == ':' && i + 1 < len && text[i + 1] == ':') last_start = i + 2;
+    }
+  }
+  if (last_start > name_end) last_start = name_end;
+}
+
+// lowest scores of the best k rows seen so far by the current query
+struct SymrankTopK {
+  size_t k;
+  std::priority_queue<double, std::vector<double>, std::greater<double>> heap;
+};
+
+constexpr double symrank_hit_max = 1 + 4 + 8 + 16;
+
+// symrank(fts_symbols [, k])
+//   scores a match of the key column higher for whole identifier hits, for hits inside the last name segment
+//   and for shorter qualified names. with k given, rows which can no longer reach the best k of the query
+//   score NULL without their tokens being inspected. this is no early termination: every match is still visited
+//   and handed to the sorter, which keeps the NULL rows after every scored one. "ORDER BY symrank(fts_symbols, k)
+//   DESC LIMIT k" returns the best k and only saves the tokenizing and scoring of the rejected rows.
+//   k <= 0 scores every row.
+static void symrank(
+    const Fts5ExtensionApi *api, Fts5Context *fts, sqlite3_context *ctx, int nVal, sqlite3_value **apVal) {
+  auto k = nVal > 0 ? (size_t) std::max(sqlite3_value_int(apVal[0]), 0) : 0;
+  const char *text;
+  int len, inst, rc;
+  if ((rc = api->xColumnText(fts, 0, &text, &len)) != SQLITE_OK || (rc = api->xInstCount(fts, &inst)) != SQLITE_OK) {
+    sqlite3_result_error_code(ctx, rc);
+    return;
+  }
+  int last_start, name_end;
+  symname(text, len, last_start, name_end);
+  auto length_penalty = (double) std::min(name_end, 999);
+
+  SymrankTopK *top = nullptr;
+  if (k > 0) {
+    top = (SymrankTopK *) api->xGetAuxdata(fts, 0);
+    if (!top) {
+      top = new SymrankTopK{k};
+      if ((rc = api->xSetAuxdata(fts, top, [](void *p) { delete (SymrankTopK *) p; })) != SQLITE_OK) {
+        sqlite3_result_error_code(ctx, rc);
+        return;
+      }
+    }
+    if (top->heap.size() >= k && inst * symrank_hit_max * 1000 - length_penalty <= top->heap.top()) {
+      sqlite3_result_null(ctx);
+      return;
+    }
+  }
+
+  // byte ranges of the key tokens, indexed by token position
+  std::vector<std::pair<int, int>> tokens;
+  rc = api->xTokenize(
+      fts, text, len, &tokens, [](void *pCtx, int tflags, const char *, int, int iStart, int iEnd) -> int {
+        if (!(tflags & FTS5_TOKEN_COLOCATED)) ((std::vector<std::pair<int, int>> *) pCtx)->emplace_back(iStart, iEnd);
+        return SQLITE_OK;
+      });
+  if (rc != SQLITE_OK) {
+    sqlite3_result_error_code(ctx, rc);
+    return;
+  }
+
+  double score = 0;
+  for (int i = 0; i < inst; i++) {
+    int phrase, col, off;
+    if (api->xInst(fts, i, &phrase, &col, &off) != SQLITE_OK || col != 0 || off >= (int) tokens.size()) continue;
+    auto [start, end] = tokens[off];
+    double hit        = 1;
+    bool whole = (start == 0 || isSep(text[start - 1])) && (end == len || isSep(text[end]));
+    if (whole) hit += 4;
+    if (start >= last_start && end <= name_end) {
+      hit += 8;
+      if (start == last_start && end == name_end) hit += 16;
+    }
+    score += hit;
+  }
+  score = score * 1000 - length_penalty;
+
+  if (top) {
+    if (top->heap.size() >= k) {
+      if (score <= top->heap.top()) {
+        sqlite3_result_null(ctx);
+        return;
+      }
+      top->heap.pop();
+    }
+    top->heap.push(score);
+  }
+  sqlite3_result_double(ctx, score);
+}
+
 void symprefix(sqlite3_context *ctx, int, sqlite3_value **values) {
   auto str = sqlite3_value_text(values[0]);
   auto len = sqlite3_value_bytes(values[0]);
@@ -174,6 +465,11 @@ extern "C" __declspec(dllexport) int sqlite3_symboltokenizer_init(
   SQLITE_EXTENSION_INIT2(pApi);
   fts5 = fts5_api_from_db(db);
   fts5->xCreateTokenizer(fts5, "symbol", nullptr, &tokenizer, nullptr);
+  fts5->xCreateTokenizer(fts5, "mangled", nullptr, &mangled_tokenizer, nullptr);
+  fts5->xCreateFunction(fts5, "symrank", nullptr, symrank, nullptr);
   sqlite3_create_function(db, "symprefix", 1, SQLITE_UTF8 | SQLITE_DIRECTONLY, nullptr, symprefix, nullptr, nullptr);
+  rc = symfuzzy_register(db);
+  if (rc == SQLITE_OK) rc = symfst_register(db);
+  if (rc == SQLITE_OK) rc = elfvtab_register(db);
   return rc;
 }
\ No newline at end of file
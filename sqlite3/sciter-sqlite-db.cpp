@@ -1,4 +1,6 @@
 #include <future>
+#include <algorithm>
+#include <string>
 #include <sciter-x-threads.h>
 #include "sciter-sqlite.h"
 #include "aux-cvt.h"
@@ -6,22 +8,129 @@
 
 namespace sqlite {
 
-DB *DB::open(sciter::string path) {
+DB::Connection::Connection(DB *owner, sqlite3 *pDb) : owner(owner), pDb(pDb) {
+  sqlite3_progress_handler(pDb, 1000, progress, this);
+}
+
+DB::DB(std::vector<sqlite3 *> const &conns) : pool(std::make_unique<TaskPool>((unsigned) conns.size())) {
+  for (auto conn : conns) connections.emplace_back(std::make_unique<Connection>(this, conn));
+}
+
+// aborts the statement stepped on a connection once its query is cancelled or runs out of time
+int DB::progress(void *self) {
+  auto conn  = (Connection *) self;
+  auto query = conn->running.load();
+  if (!query) return 0;
+  if (query->isCancelled()) return 1;
+  return std::chrono::steady_clock::now() > conn->deadline;
+}
+
+static int64_t get_option(sciter::value const &options, char const *name, int64_t def) {
+  auto v = options.get_item(name);
+  if (v.is_int()) return v.get<int>();
+  if (v.is_float()) return (int64_t) v.get<double>();
+  return def;
+}
+
+static std::string get_option(sciter::value const &options, char const *name, std::string const &def) {
+  auto v = options.get_item(name);
+  if (v.is_string() || v.is_symbol()) return aux::w2a(v.get<sciter::string>()).c_str();
+  return def;
+}
+
+static bool get_option(sciter::value const &options, char const *name, bool def) {
+  auto v = options.get_item(name);
+  if (v.is_bool()) return v.get<bool>();
+  return def;
+}
+
+static void pragma(sqlite3 *pDb, char const *name, std::string const &value) {
+  auto sql = std::string{"PRAGMA "} + name + " = " + value + ";";
+  sqlite3_exec(pDb, sql.c_str(), nullptr, nullptr, nullptr);
+}
+
+static void pragma(sqlite3 *pDb, char const *name, int64_t value) { pragma(pDb, name, std::to_string(value)); }
+
+DB *DB::open(sciter::string path, sciter::value options) {
   sqlite3 *pDb;
   if (SQLITE_OK != sqlite3_open16(path.c_str(), &pDb)) return nullptr; // undefined
-  return new DB(pDb);
+  std::vector<sqlite3 *> conns{pDb};
+
+  // the database is read-only once built, so extra readers can step queries in parallel
+  auto readers = get_option(options, "readers", (int64_t) 1);
+  aux::w2utf upath{path.c_str()};
+  for (int64_t i = 1; i < readers; i++) {
+    sqlite3 *reader = nullptr;
+    if (SQLITE_OK != sqlite3_open_v2(upath.c_str(), &reader, SQLITE_OPEN_READONLY, nullptr)) {
+      sqlite3_close_v2(reader);
+      break;
+    }
+    conns.push_back(reader);
+  }
+
+  auto mmap_size    = get_option(options, "mmap_size", (int64_t) -1);
+  auto cache_size   = get_option(options, "cache_size", (int64_t) 0);
+  auto cache_budget = get_option(options, "cache_budget", (int64_t) -1);
+  auto temp_store   = get_option(options, "temp_store", std::string{});
+  auto query_only   = get_option(options, "query_only", false);
+  for (auto conn : conns) {
+    if (mmap_size >= 0) pragma(conn, "mmap_size", mmap_size);
+    // negative cache_size is in KiB
+    if (cache_budget > 0)
+      pragma(conn, "cache_size", -std::max<int64_t>(cache_budget / (int64_t) conns.size(), 1));
+    else if (cache_size != 0)
+      pragma(conn, "cache_size", cache_size);
+    if (!temp_store.empty()) pragma(conn, "temp_store", temp_store);
+    if (query_only) pragma(conn, "query_only", 1);
+  }
+  auto db = new DB(conns);
+  if (get_option(options, "prewarm", false)) db->prewarm();
+  return db;
+}
+
+// reads every page of the fts5 index once, so the first search does not pay for faulting them in.
+// pages are shared through mmap and the os cache, so a single connection is enough.
+// it runs as the query of its connection without a deadline, so the progress handler aborts it once cancelled.
+void DB::prewarm() {
+  warmup = new Query();
+  pool->AddTask([this, query = warmup] {
+    if (query->isCancelled()) return;
+    auto &conn = acquire();
+    std::lock_guard lock{conn.mtx, std::adopt_lock};
+    if (!conn.pDb) return;
+    conn.deadline = std::chrono::steady_clock::time_point::max();
+    conn.running  = query.ptr();
+    sqlite3_exec(
+        conn.pDb,
+        "SELECT sum(length(block)) FROM fts_symbols_data;"
+        "SELECT count(*) FROM fts_symbols_idx;",
+        nullptr, nullptr, nullptr);
+    conn.running = nullptr;
+  });
+}
+
+// aborts whatever the workers are stepping, so taking the connection locks does not wait for a long query
+void DB::interrupt() {
+  for (auto &conn : connections)
+    if (conn->pDb) sqlite3_interrupt(conn->pDb);
 }
 
 // function DB.close() - closes the DB
 int DB::close() {
-  if (pDb) {
-    int result = sqlite3_close(pDb);
-    pDb        = nullptr;
+  interrupt();
+  for (auto &conn : connections) {
+    std::lock_guard lock{conn->mtx};
+    if (conn->pDb) {
+      // statements of recordsets still alive are finalized later
+      sqlite3_close_v2(conn->pDb);
+      conn->pDb = nullptr;
+    }
   }
   return 0;
 }
 
 int DB::lastRowId() {
+  auto pDb = connections[0]->pDb;
   if (pDb)
     return (int) sqlite3_last_insert_rowid(pDb);
   else {
@@ -64,6 +173,13 @@ bool bind_params(sqlite3_stmt *pst, aux::slice<sciter::value> params) {
 // function DB.exec(sql [,param1,param2,...]): [int,int] | recordset - executes SQL statement on the DB.
 
 sciter::value DB::exec(sciter::string sql, std::vector<sciter::value> params) {
+  auto &conn = *connections[0];
+  std::lock_guard lock{conn.mtx};
+  return exec(conn, sql, params);
+}
+
+sciter::value DB::exec(Connection &conn, sciter::string const &sql, std::vector<sciter::value> const &params) {
+  auto pDb = conn.pDb;
   if (!pDb) {
     throw sciter::om::exception("DB is already closed");
     return sciter::value();
@@ -91,7 +207,7 @@ sciter::value DB::exec(sciter::string sql, std::vector<sciter::value> params) {
   }
 
   // last statement could be select
-  if (r == SQLITE_ROW) return sciter::value::wrap_asset(new Recordset(pst));
+  if (r == SQLITE_ROW) return sciter::value::wrap_asset(new Recordset(pst, this));
 
   sqlite3_finalize(pst);
 
@@ -99,20 +215,62 @@ sciter::value DB::exec(sciter::string sql, std::vector<sciter::value> params) {
   return sciter::value::make_array({r, numrows_affected});
 }
 
-sciter::value DB::execCallback(sciter::string sql, std::vector<sciter::value> params, sciter::value cb) {
-  pool.AddTask([=, this] {
+// prefers an idle connection, otherwise waits for the next one in turn
+DB::Connection &DB::acquire() {
+  auto count = (unsigned) connections.size();
+  auto start = next_connection++;
+  for (unsigned i = 0; i < count; i++) {
+    auto &conn = *connections[(start + i) % count];
+    if (conn.mtx.try_lock()) return conn;
+  }
+  auto &conn = *connections[start % count];
+  conn.mtx.lock();
+  return conn;
+}
+
+DB::Connection &DB::connection_of(sqlite3_stmt *pst) {
+  auto pDb = sqlite3_db_handle(pst);
+  for (auto &conn : connections)
+    if (conn->pDb == pDb) return *conn;
+  throw sciter::om::exception("Recordset does not belong to this DB");
+}
+
+sciter::value DB::post(std::function<sciter::value(Connection &)> fn, sciter::value cb, Connection *pinned) {
+  sciter::om::hasset<Query> query = new Query();
+  // timeout is a script property, it is read here on the ui thread and never by the workers
+  auto limit = timeout;
+  pool->AddTask([=, this] {
+    if (query->isCancelled()) return;
+    if (pinned) pinned->mtx.lock();
+    auto &conn = pinned ? *pinned : acquire();
+    std::lock_guard lock{conn.mtx, std::adopt_lock};
+    conn.deadline = limit > 0 ? std::chrono::steady_clock::now() + std::chrono::milliseconds(limit)
+                              : std::chrono::steady_clock::time_point::max();
+    conn.running  = query.ptr();
     try {
-      auto res = exec(sql, params);
-      cb.call(res, {});
+      auto res     = fn(conn);
+      conn.running = nullptr;
+      if (!query->isCancelled()) cb.call(res, {});
     } catch (std::exception const &e) {
-      cb.call({}, sciter::value::make_error(e.what()));
+      conn.running = nullptr;
+      if (!query->isCancelled()) cb.call({}, sciter::value::make_error(e.what()));
     }
   });
-  return {};
+  return sciter::value::wrap_asset(query);
+}
+
+// function DB.execCallback(sql, params, cb): Query - executes SQL statement on the worker thread.
+//     - returns a token that can be used to cancel the query, newer searches should cancel older ones.
+sciter::value DB::execCallback(sciter::string sql, std::vector<sciter::value> params, sciter::value cb) {
+  // a search waiting behind the prewarm read would be slower than the cold search it was meant to speed up
+  if (warmup.ptr()) warmup->cancel();
+  return post([=, this](Connection &conn) { return exec(conn, sql, params); }, cb);
 }
 
 DB::~DB() {
-  if (pDb) sqlite3_close(pDb);
+  interrupt();
+  pool.reset();
+  close();
 }
 
 } // namespace sqlite
\ No newline at end of file
@@ -7,7 +7,7 @@ namespace sqlite {
 
 // used by DB.exec() to create an RS object
 
-Recordset::Recordset(sqlite3_stmt *pstatement) : pst(pstatement) {}
+Recordset::Recordset(sqlite3_stmt *pstatement, DB *owner) : pst(pstatement), owner(owner) {}
 
 Recordset::~Recordset() {
   if (pst) sqlite3_finalize(pst);
@@ -133,6 +133,63 @@ bool Recordset::get_next(sciter::value &index, sciter::value &val) {
     return false;
 }
 
+std::vector<sciter::value> Recordset::column_names() {
+  int total = sqlite3_column_count(pst);
+  std::vector<sciter::value> names;
+  names.reserve(total);
+  for (int n = 0; n < total; ++n)
+    names.emplace_back(sciter::value::make_string((const WCHAR *) sqlite3_column_name16(pst, n)));
+  return names;
+}
+
+// function rs.fetchMany( n:int ) : [ { field: value, ... }, ... ]
+//     - materializes up to n records in one native call, so scripts do not pay
+//       one script/native transition per field.
+sciter::value Recordset::fetchMany(int n) {
+  if (!pst) throw sciter::om::exception("Recordset is already closed");
+  auto names = column_names();
+  std::vector<sciter::value> rows;
+  if (n > 0) rows.reserve(n);
+
+  while (pst && (n < 0 || (int) rows.size() < n)) {
+    sciter::value row;
+    for (int col = 0; col < (int) names.size(); ++col) row.set_item(names[col], field_to_value(col));
+    rows.emplace_back(std::move(row));
+    next();
+  }
+
+  return sciter::value::make_array((UINT) rows.size(), rows.data());
+}
+
+sciter::value Recordset::fetchAll() { return fetchMany(-1); }
+
+// function rs.fetchColumns( n:int ) : { field: [value, ...], ... }
+sciter::value Recordset::fetchColumns(int n) {
+  if (!pst) throw sciter::om::exception("Recordset is already closed");
+  auto names = column_names();
+  std::vector<std::vector<sciter::value>> columns{names.size()};
+  int count = 0;
+
+  while (pst && (n < 0 || count < n)) {
+    for (int col = 0; col < (int) names.size(); ++col) columns[col].emplace_back(field_to_value(col));
+    count++;
+    next();
+  }
+
+  sciter::value ret;
+  for (int col = 0; col < (int) names.size(); ++col)
+    ret.set_item(names[col], sciter::value::make_array((UINT) columns[col].size(), columns[col].data()));
+  return ret;
+}
+
+// function rs.fetchCallback( n:int, cb: function(rows, err) ) : Query
+sciter::value Recordset::fetchCallback(int n, sciter::value cb) {
+  if (!pst) throw sciter::om::exception("Recordset is already closed");
+  sciter::om::hasset<Recordset> self = this;
+  // statements are stepped on the connection that prepared them
+  return owner->post([=](DB::Connection &) { return self->fetchMany(n); }, cb, &owner->connection_of(pst));
+}
+
 bool Recordset::get_prop(const std::string &field_name, sciter::value &val) {
   int n     = 0;
   int total = sqlite3_column_count(pst);
@@ -4,20 +4,90 @@
 
 #include "../include/sciter-x.h"
 #include <TaskPool.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
 
 extern const char sqlite3_version[];
 
 namespace sqlite {
 
+// token returned by DB.execCallback()
+class Query : public sciter::om::asset<Query> {
+  std::atomic<bool> cancelled{false};
+
+public:
+  Query() {}
+
+  // function query.cancel()
+  //     - aborts the query if it is still queued or running, its callback will not be called.
+  void cancel() { cancelled = true; }
+
+  // query.cancelled : true | false
+  bool isCancelled() const { return cancelled; }
+
+  SOM_PASSPORT_BEGIN(Query)
+  SOM_FUNCS(SOM_FUNC(cancel))
+  SOM_PROPS(SOM_RO_VIRTUAL_PROP(cancelled, isCancelled))
+  SOM_PASSPORT_END
+};
+
 class DB : public sciter::om::asset<DB> {
-  sqlite3 *pDb = nullptr;
-  TaskPool pool;
+  // one sqlite connection, used by at most one task at a time
+  struct Connection {
+    DB *owner;
+    sqlite3 *pDb;
+    std::mutex mtx;
+    std::atomic<Query *> running{};
+    std::chrono::steady_clock::time_point deadline;
+
+    Connection(DB *owner, sqlite3 *pDb);
+  };
+
+  // [0] is the primary connection, the rest are read-only readers
+  std::vector<std::unique_ptr<Connection>> connections;
+  std::atomic<unsigned> next_connection{};
+  // token of the prewarm read, cancelled by the next execCallback
+  sciter::om::hasset<Query> warmup;
+  // reset first in ~DB, so no worker still uses a connection when they are closed
+  std::unique_ptr<TaskPool> pool;
+
+  static int progress(void *self);
+  void interrupt();
+
+  Connection &acquire();
+  Connection &connection_of(sqlite3_stmt *pst);
+  sciter::value exec(Connection &conn, sciter::string const &sql, std::vector<sciter::value> const &params);
+
+  friend class Recordset;
+  // runs fn on a worker thread with a locked connection and passes its result to cb, returns the Query token
+  //     - the connection is picked from the idle ones unless pinned is given.
+  sciter::value post(std::function<sciter::value(Connection &)> fn, sciter::value cb, Connection *pinned = nullptr);
 
 public:
-  DB(sqlite3 *p) : pDb(p) {}
+  // db.timeout : int
+  //     - milliseconds a query posted by execCallback may run before it is aborted, 0 means no limit.
+  //     - taken when the query is posted, changing it does not affect queries already queued.
+  int timeout = 0;
+
+  DB(std::vector<sqlite3 *> const &conns);
   ~DB();
 
-  static DB *open(sciter::string path);
+  // options:
+  //     readers: int        - number of connections serving execCallback in parallel,
+  //                           all but the primary one are opened with SQLITE_OPEN_READONLY.
+  //     mmap_size: int      - PRAGMA mmap_size for every connection.
+  //     cache_size: int     - PRAGMA cache_size for every connection.
+  //     cache_budget: int   - page cache in KiB shared by all connections, overrides cache_size.
+  //     temp_store: string  - PRAGMA temp_store, #memory | #file | #default.
+  //     query_only: bool    - PRAGMA query_only for every connection.
+  //     prewarm: bool       - reads the fts5 index once in background to fault its pages in,
+  //                           the read is abandoned as soon as a query is posted by execCallback.
+  static DB *open(sciter::string path, sciter::value options);
+
+  void prewarm();
 
   int close();
   int lastRowId();
@@ -27,6 +97,7 @@ public:
 
   SOM_PASSPORT_BEGIN(DB)
   SOM_FUNCS(SOM_FUNC(exec), SOM_FUNC(execCallback), SOM_FUNC(close), SOM_FUNC(lastRowId))
+  SOM_PROPS(SOM_PROP(timeout))
   SOM_PASSPORT_END
 };
 
@@ -38,8 +109,8 @@ public:
 
   SQLite() {}
 
-  sciter::value open(sciter::string path) {
-    sqlite::DB *pdb = DB::open(path);
+  sciter::value open(sciter::string path, sciter::value options) {
+    sqlite::DB *pdb = DB::open(path, options);
     if (pdb)
       return sciter::value::wrap_asset(pdb);
     else
@@ -57,9 +128,10 @@ public:
 class Recordset : public sciter::om::asset<Recordset> {
 
   sqlite3_stmt *pst;
+  sciter::om::hasset<DB> owner;
 
 public:
-  Recordset(sqlite3_stmt *pstatement);
+  Recordset(sqlite3_stmt *pstatement, DB *owner);
 
   ~Recordset();
 
@@ -100,8 +172,28 @@ public:
   // iterator, handler of for( var v in rs ) calls
   bool get_next(sciter::value &index, sciter::value &val);
 
+  // function rs.fetchMany( n:int ) : [ { field: value, ... }, ... ]
+  //     - materializes up to n records (all remaining ones if n < 0) starting from the current one.
+  //     - leaves the recordset on the first unread record, or closes it when end-of-set is reached.
+  sciter::value fetchMany(int n);
+
+  // function rs.fetchAll() : [ { field: value, ... }, ... ]
+  //     - same as rs.fetchMany(-1).
+  sciter::value fetchAll();
+
+  // function rs.fetchColumns( n:int ) : { field: [value, ...], ... }
+  //     - same as rs.fetchMany() but returns one array per column instead of one object per record.
+  sciter::value fetchColumns(int n);
+
+  // function rs.fetchCallback( n:int, cb: function(rows, err) ) : Query
+  //     - same as rs.fetchMany() but runs on the worker thread of the DB, so the cursor
+  //       can stay open while pages are pulled in as the view scrolls.
+  sciter::value fetchCallback(int n, sciter::value cb);
+
   SOM_PASSPORT_BEGIN(Recordset)
-  SOM_FUNCS(SOM_FUNC(next), SOM_FUNC(name), SOM_FUNC(isValid), SOM_FUNC(close))
+  SOM_FUNCS(
+      SOM_FUNC(next), SOM_FUNC(name), SOM_FUNC(isValid), SOM_FUNC(close), SOM_FUNC(fetchMany), SOM_FUNC(fetchAll),
+      SOM_FUNC(fetchColumns), SOM_FUNC(fetchCallback))
   SOM_PROPS(SOM_RO_VIRTUAL_PROP(length, get_length))
   SOM_ITEM_GET(get_item)
   SOM_PROP_GET(get_prop)
@@ -110,6 +202,7 @@ public:
 
 private:
   sciter::value field_to_value(int n);
+  std::vector<sciter::value> column_names();
 };
 
 } // namespace sqlite